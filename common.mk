@@ -56,6 +56,10 @@ PRODUCT_COPY_FILES += \
 PRODUCT_COPY_FILES += \
     $(OTTER_COMMON_FOLDER)/prebuilt/usr/idc/ilitek_i2c.idc:/system/usr/idc/ilitek_i2c.idc \
 
+# Sensors
+PRODUCT_PACKAGES += \
+    sensorhubd
+
 PRODUCT_PACKAGES += \
     librs_jni \
     com.android.future.usb.accessory \
@@ -73,6 +77,10 @@ ADDITIONAL_BUILD_PROPERTIES += \
 ADDITIONAL_BUILD_PROPERTIES += \
     ro.carrier=wifi-only
 
+# boost the CPU ahead of screen rotations, see libsensors/RotationBoost.h
+ADDITIONAL_BUILD_PROPERTIES += \
+    ro.sensors.rotation.boost=1
+
 $(call inherit-product-if-exists, vendor/amazon/omap4-common/omap4-common-vendor-540_120.mk)
 $(call inherit-product, hardware/ti/wlan/mac80211/wl127x-wlan-products.mk)
 $(call inherit-product-if-exists, hardware/ti/wpan/ti-wpan-products.mk)
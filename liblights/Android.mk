@@ -19,6 +19,9 @@ include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES := lights.c
 
+# backlight latency and lock statistics in the log, see lights.c
+#LOCAL_CFLAGS += -DLIGHTS_STATS
+
 
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 
@@ -29,3 +32,5 @@ LOCAL_MODULE := lights.$(TARGET_BOOTLOADER_BOARD_NAME)
 LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
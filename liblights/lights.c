@@ -19,10 +19,14 @@
 #include <cutils/log.h>
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -31,28 +35,128 @@
 
 /******************************************************************************/
 
+/*
+ * Host builds point the sysfs files at stand-ins, e.g.
+ * -DLIGHTS_SYSFS_ROOT=\"/tmp/lights\" with the same tree below it.
+ */
+#ifndef LIGHTS_SYSFS_ROOT
+#define LIGHTS_SYSFS_ROOT ""
+#endif
+
+/*
+ * Not a framework light: lit while the sensors HAL wants the panel dark,
+ * see set_light_backlight_blank(). Must match libsensors/BMA250.h.
+ */
+#define LIGHT_ID_BACKLIGHT_BLANK "otter.backlight_blank"
+
 static pthread_once_t g_init = PTHREAD_ONCE_INIT;
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 
-char const *const LCD_FILE = "/sys/class/leds/lcd-backlight/brightness";
-char const *const ORANGE_LED_FILE = "/sys/class/leds/led-green";
-char const *const GREEN_LED_FILE = "/sys/class/leds/led-orange";
+char const *const LCD_FILE = LIGHTS_SYSFS_ROOT "/sys/class/leds/lcd-backlight/brightness";
+char const *const ORANGE_LED_FILE = LIGHTS_SYSFS_ROOT "/sys/class/leds/led-green";
+char const *const GREEN_LED_FILE = LIGHTS_SYSFS_ROOT "/sys/class/leds/led-orange";
+
+/*
+ * With LIGHTS_STATS the backlight path keeps a log2 histogram of the call
+ * latency, counts the syscalls it makes and how often g_lock was
+ * contended, and logs them every LIGHTS_STATS_PERIOD calls. The host
+ * harness in tests/ reads them with lights_stats_take() instead. Without
+ * it all of this compiles away.
+ */
+#ifdef LIGHTS_STATS
+#ifndef LIGHTS_STATS_PERIOD
+#define LIGHTS_STATS_PERIOD 256
+#endif
+
+static struct {
+	unsigned calls;
+	unsigned syscalls;
+	unsigned contended;
+	unsigned latency[32];		/* log2(us) */
+} g_stats;
+
+/* upper bound, in us, of a latency bucket */
+static unsigned stats_bound(int bucket) {
+	return bucket < 31 ? 2u << bucket : 0xffffffffu;
+}
+
+static int64_t stats_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+static void stats_lock(void) {
+	if (pthread_mutex_trylock(&g_lock)) {
+		pthread_mutex_lock(&g_lock);
+		g_stats.contended++;
+	}
+}
+
+/* called with g_lock held */
+static void stats_call(int64_t start) {
+	int64_t ns = stats_now() - start;
+	unsigned us = (unsigned)(ns > 0 ? ns / 1000 : 0) | 1;
+	int i, seen = 0, p50 = -1, p99 = -1;
+
+	g_stats.calls++;
+	g_stats.latency[31 - __builtin_clz(us)]++;
+	if (g_stats.calls < LIGHTS_STATS_PERIOD)
+		return;
+
+	for (i = 0; i < 32; i++) {
+		seen += g_stats.latency[i];
+		if (p50 < 0 && seen * 2 >= (int)g_stats.calls)
+			p50 = i;
+		if (p99 < 0 && seen * 100 >= (int)g_stats.calls * 99)
+			p99 = i;
+	}
+	ALOGD("backlight: %u calls, p50 < %uus, p99 < %uus, %u syscalls, %u contended",
+			g_stats.calls, stats_bound(p50), stats_bound(p99),
+			g_stats.syscalls, g_stats.contended);
+	memset(&g_stats, 0, sizeof(g_stats));
+}
+
+/* totals since the last call, for the host harness */
+void lights_stats_take(unsigned *calls, unsigned *syscalls, unsigned *contended) {
+	pthread_mutex_lock(&g_lock);
+	*calls = g_stats.calls;
+	*syscalls = g_stats.syscalls;
+	*contended = g_stats.contended;
+	memset(&g_stats, 0, sizeof(g_stats));
+	pthread_mutex_unlock(&g_lock);
+}
+
+#define STATS_START()		int64_t stats_start = stats_now()
+#define STATS_LOCK()		stats_lock()
+#define STATS_SYSCALL()		g_stats.syscalls++
+#define STATS_CALL()		stats_call(stats_start)
+#else
+#define STATS_START()		do { } while (0)
+#define STATS_LOCK()		pthread_mutex_lock(&g_lock)
+#define STATS_SYSCALL()		do { } while (0)
+#define STATS_CALL()		do { } while (0)
+#endif
 
 void init_globals(void) {
 	// init the mutex
 	pthread_mutex_init(&g_lock, NULL);
 }
 
+/* called with g_lock held */
 static int write_int(char const *path, int value) {
 	int fd;
 	static int already_warned = 0;
 
 	fd = open(path, O_RDWR);
+	STATS_SYSCALL();
 	if (fd >= 0) {
 		char buffer[20];
 		int bytes = sprintf(buffer, "%d\n", value);
 		int amt = write(fd, buffer, bytes);
+		STATS_SYSCALL();
 		close(fd);
+		STATS_SYSCALL();
 		return amt == -1 ? -errno : 0;
 	} else {
 		if (already_warned == 0) {
@@ -73,26 +177,55 @@ static int rgb_to_brightness(struct light_state_t const *state) {
 		+ (150*((color>>8) & 0x00ff)) + (29*(color & 0x00ff))) >> 8;
 }
 
+/*
+ * All under g_lock. The framework's level is always recorded, and only
+ * reaches the panel while it isn't blanked.
+ */
+static int brightness_requested = -1;
 /* Previous value of brightness */
 static int brightness_prev_value = -1;
+static int brightness_blanked = 0;
 
 static int set_light_backlight(struct light_device_t *dev,
 		struct light_state_t const *state) {
 	int err = 0;
 	int brightness = rgb_to_brightness(state);
-
-	if (brightness == brightness_prev_value) {
-		/* No need to set same value twice */
-		return err;
+	STATS_START();
+
+	STATS_LOCK();
+	brightness_requested = brightness;
+	/* No need to set same value twice */
+	if (!brightness_blanked && brightness != brightness_prev_value) {
+		err = write_int(LCD_FILE, brightness);
+		if (!err) {
+			brightness_prev_value = brightness;
+		}
 	}
-
-	pthread_mutex_lock(&g_lock);
-	err = write_int(LCD_FILE, brightness);
+	STATS_CALL();
 	pthread_mutex_unlock(&g_lock);
+	return err;
+}
+
+/*
+ * The face-down sensor darkens the panel through here rather than behind
+ * our back, so the framework's level is what comes back on unblank, and
+ * a screen the user turned off meanwhile stays off.
+ */
+static int set_light_backlight_blank(struct light_device_t *dev,
+		struct light_state_t const *state) {
+	int err = 0;
+	int brightness;
 
-	if (!err) {
-		brightness_prev_value = brightness;
+	pthread_mutex_lock(&g_lock);
+	brightness_blanked = is_lit(state) ? 1 : 0;
+	brightness = brightness_blanked ? 0 : brightness_requested;
+	if (brightness >= 0 && brightness != brightness_prev_value) {
+		err = write_int(LCD_FILE, brightness);
+		if (!err) {
+			brightness_prev_value = brightness;
+		}
 	}
+	pthread_mutex_unlock(&g_lock);
 	return err;
 }
 
@@ -159,6 +292,9 @@ static int open_lights(const struct hw_module_t *module, char const *name,
 	else if (0 == strcmp(LIGHT_ID_ATTENTION, name)) {
 		set_light = set_light_attention;
 	}
+	else if (0 == strcmp(LIGHT_ID_BACKLIGHT_BLANK, name)) {
+		set_light = set_light_backlight_blank;
+	}
 	else {
 		return -EINVAL;
 	}
@@ -0,0 +1,37 @@
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH := $(call my-dir)
+
+# Workloads and latency figures for the backlight path, see lights_bench.c
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := lights_bench
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := \
+	lights_bench.c \
+	../lights.c
+
+LOCAL_CFLAGS := \
+	-DLIGHTS_SYSFS_ROOT=\"/dev/shm/lights_bench\" \
+	-DLIGHTS_STATS \
+	-DLIGHTS_STATS_PERIOD=0x7fffffff
+
+LOCAL_STATIC_LIBRARIES := liblog
+
+LOCAL_LDLIBS := -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host harness for the lights HAL. lights.c is built in with its sysfs
+ * files redirected below LIGHTS_SYSFS_ROOT, which should be on tmpfs,
+ * and with LIGHTS_STATS, then driven through its hw_module_t like the
+ * framework would:
+ *
+ *   animation      a brightness fade in and out at 60 Hz, as the power
+ *                  manager does on screen on/off and auto-brightness
+ *   threads        THREADS threads setting the backlight at once
+ *
+ * It also checks that the face-down blank keeps the framework's level.
+ *
+ * Each workload reports the distribution of the per-call latency seen by
+ * the caller, the syscalls lights.c made per call and how often one call
+ * found g_lock held by another.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <hardware/lights.h>
+
+#define FRAMES		240		/* 4s of animation */
+#define THREADS		4
+#define THREAD_CALLS	5000
+
+extern struct hw_module_t HAL_MODULE_INFO_SYM;
+extern void lights_stats_take(unsigned *calls, unsigned *syscalls, unsigned *contended);
+
+static char const *const g_dirs[] = {
+	LIGHTS_SYSFS_ROOT,
+	LIGHTS_SYSFS_ROOT "/sys",
+	LIGHTS_SYSFS_ROOT "/sys/class",
+	LIGHTS_SYSFS_ROOT "/sys/class/leds",
+	LIGHTS_SYSFS_ROOT "/sys/class/leds/lcd-backlight",
+};
+#define LCD_FILE LIGHTS_SYSFS_ROOT "/sys/class/leds/lcd-backlight/brightness"
+
+static int g_failed;
+
+static int64_t now_ns(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+static int read_lcd(void) {
+	char buffer[16];
+	int fd = open(LCD_FILE, O_RDONLY);
+	int amt = fd >= 0 ? read(fd, buffer, sizeof(buffer) - 1) : -1;
+	buffer[amt > 0 ? amt : 0] = 0;
+	if (fd >= 0)
+		close(fd);
+	return amt > 0 ? atoi(buffer) : -1;
+}
+
+static struct light_device_t *open_light(char const *name) {
+	struct hw_device_t *device;
+	int err = HAL_MODULE_INFO_SYM.methods->open(&HAL_MODULE_INFO_SYM, name, &device);
+	if (err) {
+		fprintf(stderr, "couldn't open %s (%s)\n", name, strerror(-err));
+		exit(1);
+	}
+	return (struct light_device_t *)device;
+}
+
+/* times one call, in ns */
+static int64_t timed_set(struct light_device_t *dev, unsigned color) {
+	struct light_state_t state;
+	memset(&state, 0, sizeof(state));
+	state.color = 0xff000000 | color;
+	int64_t start = now_ns();
+	int err = dev->set_light(dev, &state);
+	int64_t ns = now_ns() - start;
+	if (err) {
+		fprintf(stderr, "set_light(0x%08x) failed (%s)\n", color, strerror(-err));
+		g_failed = 1;
+	}
+	return ns;
+}
+
+static unsigned gray(int level) {
+	return (level << 16) | (level << 8) | level;
+}
+
+static int compare(void const *a, void const *b) {
+	int64_t x = *(int64_t const *)a, y = *(int64_t const *)b;
+	return x < y ? -1 : x > y;
+}
+
+static void report(char const *name, int64_t *ns, int n) {
+	unsigned calls, syscalls, contended;
+	lights_stats_take(&calls, &syscalls, &contended);
+	qsort(ns, n, sizeof(*ns), compare);
+	printf("%-14s %7d %8.1f %8.1f %8.1f %8.1f %10.2f %10u\n", name, n,
+			ns[n / 2] / 1000.0, ns[n * 9 / 10] / 1000.0,
+			ns[n * 99 / 100] / 1000.0, ns[n - 1] / 1000.0,
+			(double)syscalls / n, contended);
+}
+
+/*
+ * A fade as the power manager ramps it: one step per frame, several
+ * frames in a row at the same level when the ramp is slow.
+ */
+static void animation(void) {
+	struct light_device_t *dev = open_light(LIGHT_ID_BACKLIGHT);
+	int64_t *ns = malloc(FRAMES * sizeof(*ns));
+	int64_t frame = now_ns();
+	int i, level = 0;
+
+	for (i = 0; i < FRAMES; i++) {
+		int t = i % (FRAMES / 2);
+		level = 10 + 245 * (t < FRAMES / 4 ? t : FRAMES / 2 - t) / (FRAMES / 4);
+		ns[i] = timed_set(dev, gray(level));
+
+		struct timespec next;
+		frame += 1000000000LL / 60;
+		next.tv_sec = frame / 1000000000LL;
+		next.tv_nsec = frame % 1000000000LL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+	report("animation", ns, FRAMES);
+
+	/* the panel must end up at the last level asked for */
+	if (read_lcd() != level) {
+		fprintf(stderr, "animation: brightness is %d, expected %d\n", read_lcd(), level);
+		g_failed = 1;
+	}
+	free(ns);
+	dev->common.close(&dev->common);
+}
+
+struct thread_arg {
+	struct light_device_t *dev;
+	int index;
+	int64_t *ns;
+};
+
+static void *thread_loop(void *cookie) {
+	struct thread_arg *arg = cookie;
+	int i;
+
+	for (i = 0; i < THREAD_CALLS; i++) {
+		arg->ns[i] = timed_set(arg->dev, gray((i * 7 + arg->index * 61) % 256));
+	}
+	return NULL;
+}
+
+static void threads(void) {
+	struct light_device_t *dev = open_light(LIGHT_ID_BACKLIGHT);
+	int64_t *ns = malloc(THREADS * THREAD_CALLS * sizeof(*ns));
+	pthread_t thread[THREADS];
+	struct thread_arg arg[THREADS];
+	int i;
+
+	for (i = 0; i < THREADS; i++) {
+		arg[i].dev = dev;
+		arg[i].index = i;
+		arg[i].ns = ns + i * THREAD_CALLS;
+		pthread_create(&thread[i], NULL, thread_loop, &arg[i]);
+	}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(thread[i], NULL);
+	}
+	report("threads", ns, THREADS * THREAD_CALLS);
+	free(ns);
+	dev->common.close(&dev->common);
+}
+
+static void expect_lcd(char const *step, int level) {
+	if (read_lcd() != level) {
+		fprintf(stderr, "blank: %s left brightness %d, expected %d\n", step, read_lcd(), level);
+		g_failed = 1;
+	}
+}
+
+static void blank(void) {
+	struct light_device_t *backlight = open_light(LIGHT_ID_BACKLIGHT);
+	struct light_device_t *blank = open_light("otter.backlight_blank");
+
+	timed_set(backlight, gray(200));
+	timed_set(blank, 0xffffff);
+	expect_lcd("blank", 0);
+	timed_set(backlight, gray(100));
+	expect_lcd("a new level while blanked", 0);
+	timed_set(blank, 0);
+	expect_lcd("unblank", 100);
+
+	/* the user turns the screen off while it lies face down */
+	timed_set(blank, 0xffffff);
+	timed_set(backlight, 0);
+	timed_set(blank, 0);
+	expect_lcd("unblank after screen off", 0);
+
+	timed_set(backlight, gray(150));
+	expect_lcd("screen on", 150);
+	blank->common.close(&blank->common);
+	backlight->common.close(&backlight->common);
+}
+
+int main(void) {
+	unsigned i, calls, syscalls, contended;
+
+	for (i = 0; i < sizeof(g_dirs) / sizeof(g_dirs[0]); i++) {
+		if (mkdir(g_dirs[i], 0755) && errno != EEXIST) {
+			fprintf(stderr, "couldn't create %s (%s)\n", g_dirs[i], strerror(errno));
+			return 1;
+		}
+	}
+	int fd = open(LCD_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "couldn't create %s (%s)\n", LCD_FILE, strerror(errno));
+		return 1;
+	}
+	close(fd);
+	lights_stats_take(&calls, &syscalls, &contended);
+
+	printf("%-14s %7s %8s %8s %8s %8s %10s %10s\n", "workload", "calls",
+			"p50 us", "p90 us", "p99 us", "max us", "syscalls", "contended");
+	animation();
+	threads();
+	blank();
+	return g_failed;
+}
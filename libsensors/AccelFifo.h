@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ACCEL_FIFO_H
+#define ANDROID_ACCEL_FIFO_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Batched accelerometer samples, 8 bytes each: the raw axes and the time
+ * since the previous sample in TICK_NS units. Deltas are taken from the
+ * previous sample's encoded time, so rounding never accumulates; only the
+ * oldest sample's timestamp is stored in full. When full the oldest
+ * sample makes room. N must be a power of two.
+ */
+template <int N>
+class AccelFifo {
+    typedef char n_must_be_a_power_of_two[(N & (N - 1)) ? -1 : 1];
+
+    struct sample_t {
+        int16_t raw[3];
+        uint16_t delta;
+    };
+
+    sample_t mSamples[N];
+    uint32_t mHead;
+    uint32_t mTail;
+    int64_t mOldest;            // timestamp of the sample at mTail
+    int64_t mNewest;            // encoded timestamp of the last sample
+
+public:
+    enum {
+        TICK_NS = 100000,       // deltas up to 6.5s
+        MAX_DELTA = 0xffff,
+    };
+
+    AccelFifo() : mHead(0), mTail(0), mOldest(0), mNewest(0) { }
+
+    bool isEmpty() const { return mHead == mTail; }
+    int size() const { return int(mHead - mTail); }
+    int64_t getOldestTimestamp() const { return mOldest; }
+    void clear() { mHead = mTail = 0; }
+
+    void push(const int* raw, int64_t timestamp) {
+        int64_t ticks = 0;
+        if (isEmpty()) {
+            mOldest = mNewest = timestamp;
+        } else {
+            ticks = (timestamp - mNewest + TICK_NS / 2) / TICK_NS;
+            ticks = ticks < 0 ? 0 : (ticks > int64_t(MAX_DELTA) ? int64_t(MAX_DELTA) : ticks);
+            if (size() == N) {
+                // the next one becomes the oldest
+                mTail++;
+                mOldest += mSamples[mTail & (N - 1)].delta * int64_t(TICK_NS);
+            }
+        }
+        sample_t& s(mSamples[mHead & (N - 1)]);
+        s.raw[0] = raw[0];
+        s.raw[1] = raw[1];
+        s.raw[2] = raw[2];
+        s.delta = uint16_t(ticks);
+        mNewest += ticks * TICK_NS;
+        mHead++;
+    }
+
+    // the caller checks isEmpty() first
+    void pop(int* raw, int64_t* timestamp) {
+        sample_t const& s(mSamples[mTail & (N - 1)]);
+        raw[0] = s.raw[0];
+        raw[1] = s.raw[1];
+        raw[2] = s.raw[2];
+        *timestamp = mOldest;
+        mTail++;
+        if (!isEmpty()) {
+            mOldest += mSamples[mTail & (N - 1)].delta * int64_t(TICK_NS);
+        }
+    }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_ACCEL_FIFO_H
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "AccelGovernor.h"
+
+/*****************************************************************************/
+
+AccelGovernor::AccelGovernor()
+{
+    reset();
+}
+
+void AccelGovernor::reset()
+{
+    memset(mRing, 0, sizeof(mRing));
+    memset(mSum, 0, sizeof(mSum));
+    memset(mSumSq, 0, sizeof(mSumSq));
+    memset(mHeld, 0, sizeof(mHeld));
+    mCount = 0;
+    mPos = 0;
+    mIdle = false;
+}
+
+bool AccelGovernor::addSample(const int* raw)
+{
+    if (mIdle) {
+        // a single sample away from the held value is enough to wake up
+        for (int i=0 ; i<3 ; i++) {
+            if (abs(raw[i] - mHeld[i]) > MOTION_DELTA) {
+                reset();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int* slot = mRing[mPos];
+    for (int i=0 ; i<3 ; i++) {
+        if (mCount == WINDOW) {
+            mSum[i] -= slot[i];
+            mSumSq[i] -= slot[i] * slot[i];
+        }
+        slot[i] = raw[i];
+        mSum[i] += raw[i];
+        mSumSq[i] += raw[i] * raw[i];
+    }
+    mPos = (mPos + 1) % WINDOW;
+    if (mCount < WINDOW) {
+        mCount++;
+        return false;
+    }
+
+    // WINDOW^2 * variance, summed over the axes
+    int spread = 0;
+    for (int i=0 ; i<3 ; i++) {
+        spread += WINDOW * mSumSq[i] - mSum[i] * mSum[i];
+    }
+    if (spread >= STILL_VARIANCE * WINDOW * WINDOW) {
+        return false;
+    }
+
+    for (int i=0 ; i<3 ; i++) {
+        mHeld[i] = mSum[i] / WINDOW;
+    }
+    mIdle = true;
+    return true;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ACCEL_GOVERNOR_H
+#define ANDROID_ACCEL_GOVERNOR_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Watches the variance of the most recent raw accelerometer samples and
+ * decides whether the device is stationary (idle) or moving (active).
+ * All math is done on raw LSB values, so the state is a few hundred bytes
+ * and a sample costs a handful of integer operations.
+ */
+class AccelGovernor {
+public:
+    enum {
+        WINDOW = 16,            // samples that must be still before idling
+        STILL_VARIANCE = 9,     // LSB^2, summed over the three axes
+        MOTION_DELTA = 6,       // LSB, per axis, away from the held value
+    };
+
+            AccelGovernor();
+
+    void reset();
+
+    // Feeds one raw sample, returns true if the idle state changed.
+    bool addSample(const int* raw);
+    bool isIdle() const { return mIdle; }
+
+private:
+    int mRing[WINDOW][3];
+    int mSum[3];
+    int mSumSq[3];
+    int mCount;
+    int mPos;
+    int mHeld[3];
+    bool mIdle;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_ACCEL_GOVERNOR_H
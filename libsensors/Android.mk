@@ -28,17 +28,32 @@ LOCAL_MODULE_TAGS := optional
 
 LOCAL_CFLAGS := -DLOG_TAG=\"Sensors\"
 #LOCAL_CFLAGS += -DLOG_NDEBUG=0
+# systrace trace points, see SensorTrace.h
+#LOCAL_CFLAGS += -DSENSORS_TRACE
 LOCAL_SRC_FILES := \
 	sensors.c \
 	nusensors.cpp \
-	InputEventReader.cpp \
 	SensorBase.cpp \
 	BMA250.cpp \
-	STK-ALS22x7.cpp
-
-LOCAL_SHARED_LIBRARIES := liblog libcutils
+	STK-ALS22x7.cpp \
+	AccelGovernor.cpp \
+	SignificantMotion.cpp \
+	StepCounter.cpp \
+	FaceDown.cpp \
+	GestureDetector.cpp \
+	RateTable.cpp \
+	RotationBoost.cpp \
+	SensorStats.cpp \
+	PollPolicy.cpp \
+	TimerWheel.cpp \
+	SensorArbiter.cpp \
+	SensorTrace.cpp
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libhardware libhardware_legacy
 LOCAL_PRELINK_MODULE := false
 
 include $(BUILD_SHARED_LIBRARY)
 
 endif # !TARGET_SIMULATOR
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
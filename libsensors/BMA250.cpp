@@ -24,58 +24,179 @@
 #include <sys/select.h>
 
 #include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include <hardware/lights.h>
 
 #include "BMA250.h"
+#include "SensorTrace.h"
 
 #define TAG "BMA250"
 
+#define STEP_HANDLES ((1 << ID_SD) | (1 << ID_SC))
+#define GESTURE_HANDLES ((1 << ID_SK) | (1 << ID_DT))
+
+// what sensor_t advertises until the rates have been measured
+#define DEFAULT_MIN_DELAY_US    10000
+
+// candidate delays, in ms, measured by startProbe()
+static const int sProbeDelays[] = { 5, 10, 20, 40, 66, 100, 200 };
+
 /*****************************************************************************/
 
-BMA250Sensor::BMA250Sensor()
+BMA250Sensor::BMA250Sensor(SensorArbiter* arbiter)
 : SensorBase(DEVICE_NAME, "bma250"),
+      mArbiter(arbiter),
       mEnabled(0),
-      mInputReader(32)
+      mDelayNs(40000000),
+      mIdleDelayMs(0),
+      mNextHeldEvent(0),
+      mBlankLight(NULL),
+      mBlanked(false),
+      mWrittenDelayMs(0),
+      mProbe(-1),
+      mProbeSamples(0),
+      mProbeStart(0),
+      mProbeDeadline(0),
+      mProbeNextFrame(0),
+      mBatchNs(0),
+      mFifoDeadline(0),
+      mFifoDraining(false)
 {
     mPendingEvent.version = sizeof(sensors_event_t);
     mPendingEvent.sensor = ID_A;
     mPendingEvent.type = SENSOR_TYPE_ACCELEROMETER;
     memset(mPendingEvent.data, 0, sizeof(mPendingEvent.data));
     mPendingEvent.acceleration.status = SENSOR_STATUS_ACCURACY_HIGH;
-    mEnabled = isEnabled();
+    memset(mRaw, 0, sizeof(mRaw));
+    mArbiter->attach(SensorArbiter::BMA250, BMA250_ENABLE_FILE, BMA250_DELAY_FILE);
+
+    mSigMotionEvent.version = sizeof(sensors_event_t);
+    mSigMotionEvent.sensor = ID_SM;
+    mSigMotionEvent.type = SENSOR_TYPE_SIGNIFICANT_MOTION;
+    memset(mSigMotionEvent.data, 0, sizeof(mSigMotionEvent.data));
+    mSigMotionEvent.data[0] = 1.0f;
+
+    mStepEvent.version = sizeof(sensors_event_t);
+    mStepEvent.sensor = ID_SD;
+    mStepEvent.type = SENSOR_TYPE_STEP_DETECTOR;
+    memset(mStepEvent.data, 0, sizeof(mStepEvent.data));
+    mStepEvent.data[0] = 1.0f;
+
+    mStepCountEvent.version = sizeof(sensors_event_t);
+    mStepCountEvent.sensor = ID_SC;
+    mStepCountEvent.type = SENSOR_TYPE_STEP_COUNTER;
+    memset(mStepCountEvent.data, 0, sizeof(mStepCountEvent.data));
+
+    mFaceDownEvent.version = sizeof(sensors_event_t);
+    mFaceDownEvent.sensor = ID_FD;
+    mFaceDownEvent.type = SENSOR_TYPE_FACE_DOWN;
+    memset(mFaceDownEvent.data, 0, sizeof(mFaceDownEvent.data));
+
+    mShakeEvent.version = sizeof(sensors_event_t);
+    mShakeEvent.sensor = ID_SK;
+    mShakeEvent.type = SENSOR_TYPE_SHAKE;
+    memset(mShakeEvent.data, 0, sizeof(mShakeEvent.data));
+    mShakeEvent.data[0] = 1.0f;
+
+    mDoubleTapEvent.version = sizeof(sensors_event_t);
+    mDoubleTapEvent.sensor = ID_DT;
+    mDoubleTapEvent.type = SENSOR_TYPE_DOUBLE_TAP;
+    memset(mDoubleTapEvent.data, 0, sizeof(mDoubleTapEvent.data));
+    mDoubleTapEvent.data[0] = 1.0f;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get(BMA250_IDLE_DELAY_PROPERTY, value, "0");
+    mIdleDelayMs = atoi(value);
+    ALOGD_IF(mIdleDelayMs > 0, TAG ": motion governor enabled, idle delay %dms", mIdleDelayMs);
+
+    // the lights HAL state is per process, only the framework's is the one
+    property_get(BMA250_FACE_DOWN_BLANK_PROPERTY, value, "0");
+    mBlankOnFaceDown = atoi(value) != 0 && mArbiter->isPrimary();
+    if (mBlankOnFaceDown) {
+        hw_module_t const* module;
+        int err = hw_get_module(LIGHTS_HARDWARE_MODULE_ID, &module);
+        if (!err) {
+            err = module->methods->open(module, LIGHT_ID_BACKLIGHT_BLANK,
+                    reinterpret_cast<hw_device_t**>(&mBlankLight));
+        }
+        ALOGE_IF(err, TAG ": no %s light, not blanking (%s)", LIGHT_ID_BACKLIGHT_BLANK, strerror(-err));
+        mBlankOnFaceDown = !err;
+    }
+
+    property_get(BMA250_GESTURE_SENSITIVITY_PROPERTY, value, "0");
+    mGestures.setSensitivity(atoi(value));
+
+    // rotations are followed where the screen is, and counted with the
+    // boost off too, so the boost can be judged against them
+    mFollowRotation = mArbiter->isPrimary();
+    property_get(BMA250_ROTATION_BOOST_PROPERTY, value, "0");
+    mRotationBoost.setEnabled(atoi(value) != 0 && mFollowRotation);
+
+    mRates.load(BMA250_RATES_FILE);
 }
 
 BMA250Sensor::~BMA250Sensor() {
+    if (mBlankLight) {
+        blankBacklight(false);
+        mBlankLight->common.close(&mBlankLight->common);
+    }
+}
+
+size_t BMA250Sensor::arenaSize()
+{
+    return SensorArena::align(sizeof(BMA250Sensor));
 }
 
 int BMA250Sensor::enable(int32_t handle, int en)
 {
     int err = 0;
 
-    int newState = en ? 1 : 0;
+    uint32_t newState = en ? (mEnabled | (1 << handle)) : (mEnabled & ~(1 << handle));
 
-    // ALOGD(TAG ": Setting enable: %d", en);
+    // ALOGD(TAG ": Setting enable: handle=%d, en=%d", handle, en);
 
     // don't set enable state if it's already valid
     if (mEnabled == newState) {
         return err;
     }
 
-    int fd = open(BMA250_ENABLE_FILE, O_WRONLY);
-    if(fd >= 0) {
-        char buffer[20];
-        int bytes = sprintf(buffer, "%d\n", newState);
-        err = write(fd, buffer, bytes);
-        err = err < 0 ? -errno : 0;
-        close(fd);
-    } else {
-        err = -errno;
+    // only the first and the last client switch the hardware
+    if (!mEnabled != !newState) {
+        err = writeEnable(newState ? 1 : 0);
     }
 
-    ALOGE_IF(err < 0, TAG ": Error setting enable of bma250 accelerometer (%s)", strerror(-err));
-
     if (!err) {
+        if (handle == ID_A) {
+            mGovernor.reset();
+            mRotationBoost.reset();
+            mNextHeldEvent = 0;
+            mDelayNs = 40000000; // 40ms by default for faster re-orienting
+            mFifo.clear();
+            mFifoDraining = false;
+            mBatchNs = 0;
+        } else if (handle == ID_SM) {
+            mSigMotion.reset();
+        } else if (handle == ID_FD) {
+            mFaceDown.reset();
+            blankBacklight(false);
+        } else if (GESTURE_HANDLES & (1 << handle)) {
+            if (!(mEnabled & GESTURE_HANDLES)) {
+                mGestures.reset();
+            }
+        } else if (!(mEnabled & STEP_HANDLES)) {
+            // the count survives, only the filters start over
+            mStepCounter.reset();
+        }
+        if (!mEnabled && !mRates.isValid()) {
+            startProbe();
+        } else if (!newState && mProbe >= 0) {
+            // try again next time
+            mProbe = -1;
+            mRates.clear();
+        }
         mEnabled = newState;
-        setDelay(handle, 40000000); // 40ms by default for faster re-orienting
+        updateDelay();
     }
 
     return err;
@@ -87,29 +208,305 @@ int BMA250Sensor::setDelay(int32_t handle, int64_t ns)
 
     // ALOGD(TAG ": Setting delay: %lluns", ns);
 
-    if (mEnabled) {
+    // the detectors pick their own rate
+    if (handle != ID_A)
+        return 0;
+
+    if (mEnabled & (1 << ID_A)) {
         if (ns < 0)
             return -EINVAL;
 
-        unsigned long delay = ns / 1000000;
-
-        int fd = open(BMA250_DELAY_FILE, O_WRONLY);
-        if(fd >= 0) {
-            char buffer[20];
-            int bytes = sprintf(buffer, "%lu\n", delay);
-            err = write(fd, buffer, bytes);
-            err = err < 0 ? -errno : 0;
-            close(fd);
-        } else {
-            err = -errno;
-        }
+        // a new rate always starts at full speed, the governor re-learns
+        mRates.snap(ns, &mDelayNs);
+        mGovernor.reset();
+        mNextHeldEvent = 0;
+        err = updateDelay();
+    }
+
+    return err;
+}
+
+/*
+ * While batched, accelerometer samples go to the compact FIFO instead of
+ * the event queue and are only expanded into events once the oldest one
+ * has waited ns, or the FIFO is nearly full.
+ */
+int BMA250Sensor::setBatchTimeout(int32_t handle, int64_t ns)
+{
+    if (handle != ID_A)
+        return 0;
+
+    if (ns > 0 && !mBatchNs) {
+        // the governor's held samples don't mix with batching
+        mGovernor.reset();
+        mNextHeldEvent = 0;
+        updateDelay();
+    }
+    mBatchNs = ns > 0 ? ns : 0;
+    if (!mBatchNs && !mFifo.isEmpty()) {
+        mFifoDraining = true;
+    }
+    return 0;
+}
+
+bool BMA250Sensor::isFifoDue() const
+{
+    if (mFifo.isEmpty())
+        return false;
+    return mFifoDraining || mFifo.size() >= BMA250_FIFO_EVENTS - BMA250_FIFO_EVENTS / 8 ||
+            getTimestamp() >= mFifoDeadline;
+}
+
+/*
+ * Once due the whole FIFO goes out, as room in the caller's buffer allows,
+ * so the next batch starts empty.
+ */
+int BMA250Sensor::drainFifo(sensors_event_t* data, int count)
+{
+    int n = 0;
+    while (n < count && !mFifo.isEmpty()) {
+        int raw[3];
+        sensors_event_t& event(data[n++]);
+        event = mPendingEvent;
+        mFifo.pop(raw, &event.timestamp);
+        // same mapping as processEvent()
+        event.acceleration.y = raw[0] * CONVERT_A_X;
+        event.acceleration.x = -raw[1] * CONVERT_A_Y;
+        event.acceleration.z = raw[2] * CONVERT_A_Z;
+    }
+    mFifoDraining = !mFifo.isEmpty();
+    return n;
+}
+
+static int64_t fastest(int64_t ns, int ms)
+{
+    return (ns < 0 || ms * 1000000LL < ns) ? ms * 1000000LL : ns;
+}
+
+/*
+ * The fastest delay any enabled handle needs, -1 for none. The
+ * accelerometer runs at the requested rate, or the idle rate while the
+ * governor holds, and the detectors each have a fixed rate of their own.
+ */
+int64_t BMA250Sensor::requestedDelayNs() const
+{
+    int64_t ns = -1;
+
+    if (mEnabled & (1 << ID_A)) {
+        ns = mGovernor.isIdle() ? mIdleDelayMs * 1000000LL : mDelayNs;
+    }
+    if (mEnabled & (1 << ID_SM)) {
+        ns = fastest(ns, SignificantMotion::DELAY_MS);
+    }
+    if (mEnabled & STEP_HANDLES) {
+        ns = fastest(ns, StepCounter::DELAY_MS);
+    }
+    if (mEnabled & (1 << ID_FD)) {
+        ns = fastest(ns, FaceDown::DELAY_MS);
+    }
+    if (mEnabled & GESTURE_HANDLES) {
+        ns = fastest(ns, mGestures.getDelayMs());
+    }
+    return ns;
+}
+
+int BMA250Sensor::updateDelay()
+{
+    int64_t ns = requestedDelayNs();
+    if (ns < 0 || mProbe >= 0)
+        return 0;
+    int64_t period;
+    return writeDelay(mRates.snap(ns, &period));
+}
+
+/*
+ * The nodes are shared with the other HAL instances, see SensorArbiter.
+ */
+int BMA250Sensor::writeEnable(int en)
+{
+    int err = mArbiter->setEnable(SensorArbiter::BMA250, en);
+
+    ALOGE_IF(err < 0, TAG ": Error setting enable of bma250 accelerometer (%s)", strerror(-err));
 
-        ALOGE_IF(err < 0, TAG ": Error setting delay of bma250 accelerometer (%s)", strerror(-err));
+    return err;
+}
+
+int BMA250Sensor::writeDelay(unsigned long delay)
+{
+    int err = mArbiter->setDelay(SensorArbiter::BMA250, delay);
+
+    ALOGE_IF(err < 0, TAG ": Error setting delay of bma250 accelerometer (%s)", strerror(-err));
+    if (!err) {
+        mWrittenDelayMs = delay;
     }
 
     return err;
 }
 
+int64_t BMA250Sensor::getWatchdogPeriod() const
+{
+    return mEnabled ? mWrittenDelayMs * 1000000LL : 0;
+}
+
+/*
+ * Seen in the field: the part stops delivering while enable still reads
+ * 1. Cycling the enable, programming the delay again and reopening the
+ * input device brings it back.
+ */
+int BMA250Sensor::recover()
+{
+    int err = mArbiter->restart(SensorArbiter::BMA250);
+    ALOGE_IF(err, TAG ": Error restarting bma250 accelerometer (%s)", strerror(-err));
+    mInputReader.clear();
+    int fd = reopenInput();
+    return err ? err : (fd < 0 ? fd : 0);
+}
+
+/*
+ * While the device is still the hardware runs at the idle delay and the
+ * last sample is repeated at the requested rate, so clients see an
+ * unchanged stream. Any motion in an idle sample restores the requested
+ * delay right away.
+ */
+void BMA250Sensor::governSample()
+{
+    if (!mIdleDelayMs || mDelayNs >= mIdleDelayMs * 1000000LL) {
+        return;
+    }
+
+    if (!mGovernor.addSample(mRaw)) {
+        if (mGovernor.isIdle()) {
+            mNextHeldEvent = mPendingEvent.timestamp + mDelayNs;
+        }
+        return;
+    }
+
+    if (mGovernor.isIdle()) {
+        // ALOGD(TAG ": stationary, dropping to %dms", mIdleDelayMs);
+        mNextHeldEvent = mPendingEvent.timestamp + mDelayNs;
+    } else {
+        // ALOGD(TAG ": motion, back to %lldns", mDelayNs);
+        mNextHeldEvent = 0;
+    }
+    updateDelay();
+}
+
+/*
+ * Switches the panel off and back on through the lights HAL, which keeps
+ * whatever level the framework set meanwhile and puts that back, so a
+ * screen turned off while face down stays off.
+ */
+void BMA250Sensor::blankBacklight(bool blank)
+{
+    if (!mBlankOnFaceDown || blank == mBlanked)
+        return;
+
+    struct light_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.color = blank ? 0xffffffff : 0;
+    int err = mBlankLight->set_light(mBlankLight, &state);
+    ALOGE_IF(err, TAG ": couldn't %s the backlight (%s)", blank ? "blank" : "unblank", strerror(-err));
+    if (!err) {
+        mBlanked = blank;
+    }
+}
+
+/*
+ * The driver accepts any delay but the part only has a few bandwidths, so
+ * what a delay really delivers is measured once, on the first enable, by
+ * stepping through sProbeDelays while the sensor runs normally, and saved
+ * for the following boots. Meanwhile processFrame() thins the stream out
+ * to the requested rate; the slower delays leave gaps for a few seconds.
+ *
+ * Another HAL instance using the part changes what is programmed, so the
+ * probe only runs while this one has it alone, and in the framework's.
+ */
+void BMA250Sensor::startProbe()
+{
+    if (!mArbiter->isPrimary() || mArbiter->isUsedElsewhere(SensorArbiter::BMA250))
+        return;
+    ALOGD(TAG ": measuring delivered rates");
+    mRates.clear();
+    mProbe = -1;
+    mProbeNextFrame = 0;
+    nextProbe(0);
+}
+
+void BMA250Sensor::nextProbe(int64_t periodNs)
+{
+    if (mProbe >= 0) {
+        mRates.add(sProbeDelays[mProbe], periodNs);
+    }
+    if (mArbiter->isUsedElsewhere(SensorArbiter::BMA250)) {
+        // the rest would measure someone else's delay, try again next time
+        ALOGD(TAG ": part shared, rate measurement abandoned");
+        mProbe = -1;
+        mRates.clear();
+        updateDelay();
+        return;
+    }
+    if (++mProbe < int(ARRAY_SIZE(sProbeDelays))) {
+        int64_t timeoutMs = sProbeDelays[mProbe] * int64_t(RateTable::PROBE_TIMEOUT_PERIODS);
+        if (timeoutMs < RateTable::PROBE_TIMEOUT_MIN_MS) {
+            timeoutMs = RateTable::PROBE_TIMEOUT_MIN_MS;
+        }
+        mProbeSamples = 0;
+        mProbeDeadline = getTimestamp() + timeoutMs * 1000000LL;
+        writeDelay(sProbeDelays[mProbe]);
+        return;
+    }
+
+    mProbe = -1;
+    if (mRates.isValid()) {
+        mRates.save(BMA250_RATES_FILE);
+        ALOGD(TAG ": fastest delivered period %lldus", (long long)(mRates.getMinPeriod() / 1000));
+    }
+    mRates.snap(mDelayNs, &mDelayNs);
+    updateDelay();
+}
+
+void BMA250Sensor::probeSample(int64_t time)
+{
+    // the first sample may still come at the previous delay
+    int n = mProbeSamples++;
+    if (n == 1) {
+        mProbeStart = time;
+    } else if (n == 1 + RateTable::PROBE_SAMPLES) {
+        nextProbe((time - mProbeStart) / RateTable::PROBE_SAMPLES);
+    }
+}
+
+bool BMA250Sensor::isHeldEventDue() const
+{
+    return mNextHeldEvent && getTimestamp() >= mNextHeldEvent;
+}
+
+bool BMA250Sensor::hasPendingEvents() const
+{
+    return !mQueue.isEmpty() || isHeldEventDue() || isFifoDue() ||
+            (mProbe >= 0 && getTimestamp() >= mProbeDeadline);
+}
+
+int64_t BMA250Sensor::getDeadline() const
+{
+    if (!mQueue.isEmpty() || mFifoDraining)
+        return getTimestamp();
+    int64_t deadline = mNextHeldEvent;
+    if (mProbe >= 0 && (!deadline || mProbeDeadline < deadline)) {
+        deadline = mProbeDeadline;
+    }
+    if (!mFifo.isEmpty() && (!deadline || mFifoDeadline < deadline)) {
+        deadline = mFifoDeadline;
+    }
+    return deadline;
+}
+
+bool BMA250Sensor::canRelease() const
+{
+    // the step count carries over from one activation to the next
+    return !mStepCounter.getSteps();
+}
+
 int BMA250Sensor::readEvents(sensors_event_t* data, int count)
 {
     // ALOGD(TAG ": readEvents: count == %d", count);
@@ -117,31 +514,168 @@ int BMA250Sensor::readEvents(sensors_event_t* data, int count)
     if (count < 1)
         return -EINVAL;
 
+    if (mProbe >= 0 && getTimestamp() >= mProbeDeadline) {
+        // this delay delivers nothing
+        nextProbe(0);
+    }
+
     ssize_t n = mInputReader.fill(data_fd);
+    SENSOR_TRACE_INT("bma250 fill", n);
     if (n < 0)
         return n;
 
-    int numEventReceived = 0;
-    input_event const* event;
-
-    while (count && mInputReader.readEvent(&event)) {
-        // ALOGD(TAG ": event (type=%d, code=%d, value=%d)", event->type, event->code, event->value);
-        if ((event->type == EV_ABS) || (event->type == EV_REL)) {
-            processEvent(event->code, event->value);
-        } else if (event->type == EV_SYN) {
-            mPendingEvent.timestamp = timevalToNano(event->time);
-            *data++ = mPendingEvent;
-            count--;
-            numEventReceived++;
-        } else {
-            ALOGE(TAG ": unknown event (type=%d, code=%d)", event->type, event->code);
+    input_event const* events;
+    size_t ready;
+
+    // decode only as long as a whole frame's worth of events fits
+    while (mQueue.room() >= maxFrameEvents && (ready = mInputReader.span(&events))) {
+        size_t i = 0;
+        for ( ; i < ready && mQueue.room() >= maxFrameEvents ; i++) {
+            input_event const* event = &events[i];
+            // ALOGD(TAG ": event (type=%d, code=%d, value=%d)", event->type, event->code, event->value);
+            if ((event->type == EV_ABS) || (event->type == EV_REL)) {
+                if (!mDropping) {
+                    processEvent(event->code, event->value);
+                }
+            } else if (event->type == EV_SYN) {
+                int frame = checkSyn(event);
+                if (frame == FRAME_RESYNC) {
+                    resync();
+                }
+                if (frame != FRAME_SKIP) {
+                    mPendingEvent.timestamp = timevalToNano(event->time);
+                    processFrame();
+                }
+            } else {
+                ALOGE(TAG ": unknown event (type=%d, code=%d)", event->type, event->code);
+            }
         }
-        mInputReader.next();
+        mInputReader.consume(i);
     }
 
+    // repeat the held sample while the hardware is idling
+    if (mQueue.room() && isHeldEventDue()) {
+        sensors_event_t held = mPendingEvent;
+        held.timestamp = mNextHeldEvent;
+        mQueue.push(held);
+        mNextHeldEvent += mDelayNs;
+        int64_t now = getTimestamp();
+        if (mNextHeldEvent <= now) {
+            mNextHeldEvent = now + mDelayNs;
+        }
+    }
+
+    int numEventReceived = mQueue.read(data, count);
+    if (numEventReceived < count && isFifoDue()) {
+        numEventReceived += drainFifo(data + numEventReceived, count - numEventReceived);
+    }
     return numEventReceived;
 }
 
+/*
+ * Hands a complete sample to every enabled consumer and queues whatever
+ * they report for it.
+ */
+void BMA250Sensor::processFrame()
+{
+    const int64_t time = mPendingEvent.timestamp;
+
+    if (mProbe >= 0) {
+        probeSample(time);
+        // nobody asked for the probe's rates, a little early is on time
+        if (time < mProbeNextFrame)
+            return;
+        mProbeNextFrame = time + requestedDelayNs() * 7 / 8;
+    }
+
+    if ((mEnabled & (1 << ID_A)) && mBatchNs) {
+        if (mFifo.isEmpty()) {
+            mFifoDeadline = getTimestamp() + mBatchNs;
+        }
+        mFifo.push(mRaw, time);
+    } else if (mEnabled & (1 << ID_A)) {
+        mQueue.push(mPendingEvent);
+        governSample();
+        // batched clients are not the ones rotating the screen
+        if (mFollowRotation) {
+            mRotationBoost.addSample(mRaw, time);
+        }
+    }
+
+    // significant motion fires once, then turns itself off
+    if ((mEnabled & (1 << ID_SM)) && mSigMotion.addSample(mRaw)) {
+        mSigMotionEvent.timestamp = time;
+        mQueue.push(mSigMotionEvent);
+        enable(ID_SM, 0);
+    }
+
+    if ((mEnabled & STEP_HANDLES) && mStepCounter.addSample(mRaw, time)) {
+        if (mEnabled & (1 << ID_SD)) {
+            mStepEvent.timestamp = time;
+            mQueue.push(mStepEvent);
+        }
+        if (mEnabled & (1 << ID_SC)) {
+            mStepCountEvent.timestamp = time;
+            mStepCountEvent.u64.step_counter = mStepCounter.getSteps();
+            mQueue.push(mStepCountEvent);
+        }
+    }
+
+    if ((mEnabled & (1 << ID_FD)) && mFaceDown.addSample(mRaw)) {
+        mFaceDownEvent.timestamp = time;
+        mFaceDownEvent.data[0] = mFaceDown.isFaceDown() ? 1.0f : 0.0f;
+        mQueue.push(mFaceDownEvent);
+        blankBacklight(mFaceDown.isFaceDown());
+    }
+
+    if (mEnabled & GESTURE_HANDLES) {
+        detectGestures(time);
+    }
+}
+
+/*
+ * Shake and double tap are one-shot: each reports its gesture once and
+ * turns itself off. The detector drops to its idle rate when nothing
+ * moves, which only takes effect if no other handle wants it faster.
+ */
+void BMA250Sensor::detectGestures(int64_t time)
+{
+    const bool idle = mGestures.isIdle();
+    const int found = mGestures.addSample(mRaw, time);
+
+    if ((found & GestureDetector::SHAKE) && (mEnabled & (1 << ID_SK))) {
+        mShakeEvent.timestamp = time;
+        mQueue.push(mShakeEvent);
+        enable(ID_SK, 0);
+    }
+    if ((found & GestureDetector::DOUBLE_TAP) && (mEnabled & (1 << ID_DT))) {
+        mDoubleTapEvent.timestamp = time;
+        mQueue.push(mDoubleTapEvent);
+        enable(ID_DT, 0);
+    }
+    if (idle != mGestures.isIdle()) {
+        updateDelay();
+    }
+}
+
+/*
+ * The axes decoded so far may mix two samples after an overflow, so the
+ * current ones are read back from the device instead.
+ */
+void BMA250Sensor::resync()
+{
+    static const int codes[] = {
+        EVENT_TYPE_ACCEL_X, EVENT_TYPE_ACCEL_Y, EVENT_TYPE_ACCEL_Z
+    };
+    for (size_t i=0 ; i<ARRAY_SIZE(codes) ; i++) {
+        int value;
+        if (!getAbsValue(codes[i], &value)) {
+            processEvent(codes[i], value);
+        }
+    }
+    SENSOR_TRACE_INT("bma250 dropped", mDropped);
+}
+
 void BMA250Sensor::processEvent(int code, int value)
 {
 /*
@@ -152,34 +686,30 @@ void BMA250Sensor::processEvent(int code, int value)
 */
     switch (code) {
         case EVENT_TYPE_ACCEL_X:
+            mRaw[0] = value;
             mPendingEvent.acceleration.y = value * CONVERT_A_X;
             break;
         case EVENT_TYPE_ACCEL_Y:
+            mRaw[1] = value;
             mPendingEvent.acceleration.x = -value * CONVERT_A_Y;
             break;
         case EVENT_TYPE_ACCEL_Z:
+            mRaw[2] = value;
             mPendingEvent.acceleration.z = value * CONVERT_A_Z;
             break;
     }
 }
 
-int BMA250Sensor::isEnabled()
+/*****************************************************************************/
+
+/*
+ * For sensors.c: the minDelay to advertise, from the measured rates once
+ * there are some.
+ */
+int bma250_min_delay_us(void)
 {
-    int ret = 0;
-    int fd = open(BMA250_ENABLE_FILE, O_RDONLY);
-    if (fd >= 0) {
-        char buffer[20];
-        int amt = read(fd, buffer, 20);
-        close(fd);
-        if(amt > 0) {
-            ret = (buffer[0] == '1');
-        } else {
-            ALOGE(TAG ": isEnable failed to read (%s)", strerror(errno));
-        }
-    } else {
-        ALOGE(TAG ": isEnabled failed to open %s", BMA250_ENABLE_FILE);
-    }
-    // ALOGD(TAG ": isEnabled == %d", ret);
-    return ret;
+    RateTable rates;
+    if (!rates.load(BMA250_RATES_FILE))
+        return DEFAULT_MIN_DELAY_US;
+    return int(rates.getMinPeriod() / 1000);
 }
-
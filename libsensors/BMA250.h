@@ -26,30 +26,117 @@
 #include "nusensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "SensorArena.h"
+#include "SensorArbiter.h"
+#include "AccelGovernor.h"
+#include "SignificantMotion.h"
+#include "StepCounter.h"
+#include "FaceDown.h"
+#include "GestureDetector.h"
+#include "RotationBoost.h"
+#include "RateTable.h"
+#include "SensorEventQueue.h"
+#include "AccelFifo.h"
 
-#define BMA250_ENABLE_FILE "/sys/bus/i2c/devices/4-0018/enable"
-#define BMA250_DELAY_FILE  "/sys/bus/i2c/devices/4-0018/delay"
+#define BMA250_ENABLE_FILE SENSORS_ROOT "/sys/bus/i2c/devices/4-0018/enable"
+#define BMA250_DELAY_FILE  SENSORS_ROOT "/sys/bus/i2c/devices/4-0018/delay"
+// rates measured on the first enable, see BMA250Sensor::startProbe()
+#define BMA250_RATES_FILE  SENSORS_ROOT "/data/system/sensors.bma250.rates"
+
+// hardware delay used while the governor sees no motion, 0 disables it
+#define BMA250_IDLE_DELAY_PROPERTY "ro.sensors.bma250.idle_ms"
+
+// 1 to switch the backlight off while the face-down sensor reports it
+#define BMA250_FACE_DOWN_BLANK_PROPERTY "ro.sensors.facedown.blank"
+// private light of our lights HAL, see liblights/lights.c
+#define LIGHT_ID_BACKLIGHT_BLANK "otter.backlight_blank"
+
+// 1 to 9, how easily shakes and double taps trigger
+#define BMA250_GESTURE_SENSITIVITY_PROPERTY "ro.sensors.gesture.sensitivity"
+
+// 1 to boost the CPU when the accelerometer sees the screen rotating
+#define BMA250_ROTATION_BOOST_PROPERTY "ro.sensors.rotation.boost"
 
 /*****************************************************************************/
 
 struct input_event;
+struct light_device_t;
 
 class BMA250Sensor : public SensorBase {
 public:
-            BMA250Sensor();
+            BMA250Sensor(SensorArbiter* arbiter);
     virtual ~BMA250Sensor();
+    static size_t arenaSize();
 
     virtual int setDelay(int32_t handle, int64_t ns);
+    virtual int setBatchTimeout(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled);
     virtual int readEvents(sensors_event_t* data, int count);
+    virtual bool hasPendingEvents() const;
+    virtual int64_t getDeadline() const;
+    virtual bool canRelease() const;
+    virtual int64_t getWatchdogPeriod() const;
+    virtual int recover();
     void processEvent(int code, int value);
 
 private:
-    int mEnabled;
-    InputEventCircularReader mInputReader;
+    enum {
+        numInputEvents = 32,
+        maxFrameEvents = 7,     // one per handle served by this driver
+    };
+
+    SensorArbiter* mArbiter;
+    uint32_t mEnabled;          // one bit per handle
+    InputEventRing<numInputEvents> mInputReader;
+    SensorEventQueue<16> mQueue;
     sensors_event_t mPendingEvent;
+    int mRaw[3];
+    int64_t mDelayNs;
+    int mIdleDelayMs;
+    AccelGovernor mGovernor;
+    int64_t mNextHeldEvent;
+    SignificantMotion mSigMotion;
+    sensors_event_t mSigMotionEvent;
+    StepCounter mStepCounter;
+    sensors_event_t mStepEvent;
+    sensors_event_t mStepCountEvent;
+    FaceDown mFaceDown;
+    sensors_event_t mFaceDownEvent;
+    bool mBlankOnFaceDown;
+    struct light_device_t* mBlankLight;     // NULL unless mBlankOnFaceDown
+    bool mBlanked;
+    GestureDetector mGestures;
+    sensors_event_t mShakeEvent;
+    sensors_event_t mDoubleTapEvent;
+    RotationBoost mRotationBoost;
+    bool mFollowRotation;       // in the framework's instance only
+    unsigned long mWrittenDelayMs;
+    RateTable mRates;
+    int mProbe;                 // delay being measured, -1 when not probing
+    int mProbeSamples;
+    int64_t mProbeStart;
+    int64_t mProbeDeadline;
+    int64_t mProbeNextFrame;    // clients see no frame before this while probing
+    AccelFifo<BMA250_FIFO_EVENTS> mFifo;
+    int64_t mBatchNs;           // 0 unless the accelerometer is batched
+    int64_t mFifoDeadline;      // monotonic, when the oldest sample is due
+    bool mFifoDraining;
 
-    int isEnabled();
+    int64_t requestedDelayNs() const;
+    int updateDelay();
+    int writeEnable(int enabled);
+    int writeDelay(unsigned long ms);
+    bool isHeldEventDue() const;
+    void processFrame();
+    void resync();
+    void governSample();
+    void blankBacklight(bool blank);
+    void detectGestures(int64_t time);
+    void startProbe();
+    void probeSample(int64_t time);
+    void nextProbe(int64_t periodNs);
+    bool isFifoDue() const;
+    int drainFifo(sensors_event_t* data, int count);
 };
 
 /*****************************************************************************/
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "FaceDown.h"
+
+/*****************************************************************************/
+
+FaceDown::FaceDown()
+{
+    reset();
+}
+
+void FaceDown::reset()
+{
+    mRun = 0;
+    mFaceDown = false;
+}
+
+bool FaceDown::addSample(const int* raw)
+{
+    bool down;
+    if (mFaceDown) {
+        down = raw[2] < UP_LSB;
+    } else {
+        down = raw[2] < DOWN_LSB && abs(raw[0]) < FLAT_LSB && abs(raw[1]) < FLAT_LSB;
+    }
+
+    if (down == mFaceDown) {
+        mRun = 0;
+        return false;
+    }
+
+    if (++mRun < (mFaceDown ? LEAVE_SAMPLES : ENTER_SAMPLES))
+        return false;
+
+    mRun = 0;
+    mFaceDown = down;
+    return true;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FACE_DOWN_H
+#define ANDROID_FACE_DOWN_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Tells when the device lies flat with the screen towards the table. The
+ * state flips only once enough consecutive raw samples agree: a long run
+ * to enter, so handling the device doesn't blank it, and a short one to
+ * leave, so picking it up does not have to wait.
+ */
+class FaceDown {
+public:
+    enum {
+        DELAY_MS = 200,         // hardware delay while only we are enabled
+        DOWN_LSB = -200,        // z below ~-0.8g is face down
+        UP_LSB = -150,          // and above ~-0.6g no longer is
+        FLAT_LSB = 80,          // x and y within ~0.3g
+        ENTER_SAMPLES = 10,     // 2s at DELAY_MS
+        LEAVE_SAMPLES = 2,
+    };
+
+            FaceDown();
+
+    void reset();
+
+    // Feeds one raw sample, returns true when the state changed.
+    bool addSample(const int* raw);
+    bool isFaceDown() const { return mFaceDown; }
+
+private:
+    int mRun;                   // consecutive samples disagreeing with the state
+    bool mFaceDown;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_FACE_DOWN_H
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "GestureDetector.h"
+
+/*****************************************************************************/
+
+GestureDetector::GestureDetector()
+{
+    setSensitivity(DEFAULT_SENSITIVITY);
+    reset();
+}
+
+void GestureDetector::setSensitivity(int sensitivity)
+{
+    if (sensitivity < 1 || sensitivity > 9) {
+        sensitivity = DEFAULT_SENSITIVITY;
+    }
+    const int scale = 10 - sensitivity;     // 5 at the default
+
+    mTapLsb = TAP_LSB * scale / 5;
+    mWakeLsb = mTapLsb / 2 > QUIET_LSB ? mTapLsb / 2 : QUIET_LSB + 1;
+    // only the part above 1g scales, gravity alone must never count
+    int shake = 256 + (SHAKE_LSB - 256) * scale / 5;
+    mShakeLsb2 = shake * shake;
+}
+
+void GestureDetector::reset()
+{
+    mPrimed = false;
+    mIdle = false;
+    mLastJerk = 0;
+    mCooldownEnd = 0;
+    clearGestures();
+}
+
+void GestureDetector::clearGestures()
+{
+    mTapState = TAP_NONE;
+    mPeak = 0;
+    mFirstTap = 0;
+    mStrong = false;
+    mStrokes = 0;
+    mFirstStroke = 0;
+    mLastStroke = 0;
+}
+
+int GestureDetector::addSample(const int* raw, int64_t timestamp)
+{
+    int jerk = 0;
+    for (int i=0 ; i<3 ; i++) {
+        jerk += abs(raw[i] - mLast[i]);
+        mLast[i] = raw[i];
+    }
+    if (!mPrimed) {
+        mPrimed = true;
+        mLastJerk = timestamp;
+        return 0;
+    }
+
+    if (mIdle) {
+        if (jerk >= mWakeLsb) {
+            mIdle = false;
+            mLastJerk = timestamp;
+        }
+        return 0;
+    }
+
+    if (jerk > QUIET_LSB) {
+        mLastJerk = timestamp;
+    } else if (timestamp - mLastJerk >= IDLE_AFTER_MS * 1000000LL) {
+        clearGestures();
+        mIdle = true;
+        return 0;
+    }
+
+    if (timestamp < mCooldownEnd)
+        return 0;
+
+    int found = addStroke(raw, timestamp);
+    if (!found) {
+        found = addTap(jerk, timestamp);
+    }
+    if (found) {
+        clearGestures();
+        mCooldownEnd = timestamp + COOLDOWN_MS * 1000000LL;
+    }
+    return found;
+}
+
+/*
+ * A peak must be over within TAP_SETTLE_MS, anything still moving after
+ * that is handling, not tapping, and forgets the taps seen so far. So is
+ * a peak still swinging at shake level, as each turn of a shake is.
+ */
+int GestureDetector::addTap(int jerk, int64_t timestamp)
+{
+    if (mTapState == TAP_ONE && timestamp - mFirstTap > TAP_MAX_GAP_MS * 1000000LL) {
+        mTapState = TAP_NONE;
+    }
+
+    switch (mTapState) {
+        case TAP_NONE:
+        case TAP_ONE:
+            if (jerk >= mTapLsb) {
+                mPeak = timestamp;
+                mTapState = mTapState == TAP_NONE ? TAP_FIRST : TAP_SECOND;
+            }
+            break;
+
+        case TAP_FIRST:
+        case TAP_SECOND:
+            if (timestamp - mPeak < TAP_SETTLE_MS * 1000000LL)
+                break;
+            if (jerk >= mTapLsb || mStrong) {
+                mTapState = TAP_NONE;
+                break;
+            }
+            if (mTapState == TAP_FIRST) {
+                mFirstTap = mPeak;
+                mTapState = TAP_ONE;
+            } else if (mPeak - mFirstTap >= TAP_MIN_GAP_MS * 1000000LL) {
+                return DOUBLE_TAP;
+            } else {
+                // the first tap bouncing
+                mTapState = TAP_ONE;
+            }
+            break;
+    }
+    return 0;
+}
+
+int GestureDetector::addStroke(const int* raw, int64_t timestamp)
+{
+    const int magnitude2 = raw[0]*raw[0] + raw[1]*raw[1] + raw[2]*raw[2];
+    const bool strong = magnitude2 >= mShakeLsb2;
+    const bool rising = strong && !mStrong;
+    mStrong = strong;
+
+    if (!rising || timestamp - mLastStroke < STROKE_GAP_MS * 1000000LL)
+        return 0;
+
+    if (!mStrokes || timestamp - mFirstStroke > SHAKE_WINDOW_MS * 1000000LL) {
+        mStrokes = 0;
+        mFirstStroke = timestamp;
+    }
+    mLastStroke = timestamp;
+    return ++mStrokes >= SHAKE_STROKES ? SHAKE : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GESTURE_DETECTOR_H
+#define ANDROID_GESTURE_DETECTOR_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Shake and double-tap detection on raw accelerometer samples.
+ *
+ * A tap is a jerk (the change from one sample to the next, summed over
+ * the axes) above the tap threshold that dies out within TAP_SETTLE_MS,
+ * leaving the magnitude under the shake threshold, and a double tap is
+ * two of them TAP_MIN_GAP_MS to TAP_MAX_GAP_MS apart.
+ * A shake is SHAKE_STROKES excursions of the magnitude above the shake
+ * threshold within SHAKE_WINDOW_MS. Each gesture is reported once, then
+ * the detector ignores everything for COOLDOWN_MS.
+ *
+ * After IDLE_AFTER_MS without any jerk the detector asks for the slow
+ * IDLE_DELAY_MS and only looks for a jerk large enough to wake it up, so
+ * the first tap of a double tap made from idle may be lost.
+ */
+class GestureDetector {
+public:
+    enum {
+        DELAY_MS = 10,          // taps are over within a few tens of ms
+        IDLE_DELAY_MS = 100,
+        IDLE_AFTER_MS = 5000,
+        QUIET_LSB = 8,          // jerk within sensor noise
+        TAP_LSB = 80,           // ~0.3g from one sample to the next
+        TAP_SETTLE_MS = 60,
+        TAP_MIN_GAP_MS = 100,
+        TAP_MAX_GAP_MS = 500,
+        SHAKE_LSB = 384,        // 1.5g
+        SHAKE_STROKES = 4,
+        SHAKE_WINDOW_MS = 1500,
+        STROKE_GAP_MS = 80,
+        COOLDOWN_MS = 1000,
+        DEFAULT_SENSITIVITY = 5,
+    };
+
+    enum {
+        SHAKE = 0x1,
+        DOUBLE_TAP = 0x2,
+    };
+
+            GestureDetector();
+
+    // 1 (firm gestures only) to 9 (hair trigger), DEFAULT_SENSITIVITY
+    // gives the thresholds above.
+    void setSensitivity(int sensitivity);
+    void reset();
+
+    // Feeds one raw sample, returns the gestures it completes.
+    int addSample(const int* raw, int64_t timestamp);
+    bool isIdle() const { return mIdle; }
+    int getDelayMs() const { return mIdle ? IDLE_DELAY_MS : DELAY_MS; }
+
+private:
+    enum {
+        TAP_NONE,
+        TAP_FIRST,              // first peak, waiting for it to settle
+        TAP_ONE,                // one tap, waiting for the second
+        TAP_SECOND,
+    };
+
+    int mTapLsb;
+    int mWakeLsb;
+    int mShakeLsb2;             // squared, compared to the magnitude
+    int mLast[3];
+    bool mPrimed;
+    bool mIdle;
+    int64_t mLastJerk;
+    int64_t mCooldownEnd;
+    int mTapState;
+    int64_t mPeak;
+    int64_t mFirstTap;
+    bool mStrong;
+    int mStrokes;
+    int64_t mFirstStroke;
+    int64_t mLastStroke;
+
+    void clearGestures();
+    int addTap(int jerk, int64_t timestamp);
+    int addStroke(const int* raw, int64_t timestamp);
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_GESTURE_DETECTOR_H
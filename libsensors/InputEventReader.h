@@ -19,27 +19,81 @@
 
 #include <stdint.h>
 #include <errno.h>
+#include <unistd.h>
 #include <sys/cdefs.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
-/*****************************************************************************/
+#include <linux/input.h>
 
-struct input_event;
+/*****************************************************************************/
 
-class InputEventCircularReader
+/*
+ * Ring of raw input events with a compile-time, power of two capacity, so
+ * wrapping is a mask and the storage lives inline in the driver.
+ *
+ * Instead of handing out one event at a time, span() returns the longest
+ * run of ready events that is contiguous in memory; the driver decodes it
+ * as a plain array and then consume()s what it used.
+ */
+template <size_t N>
+class InputEventRing
 {
-    struct input_event* const mBuffer;
-    struct input_event* const mBufferEnd;
-    struct input_event* mHead;
-    struct input_event* mCurr;
-    ssize_t mFreeSpace;
+    typedef char capacity_must_be_a_power_of_two[(N & (N - 1)) == 0 ? 1 : -1];
+
+    struct input_event mBuffer[N];
+    uint32_t mHead;     // events ever written
+    uint32_t mTail;     // events ever consumed
 
 public:
-    InputEventCircularReader(size_t numEvents);
-    ~InputEventCircularReader();
-    ssize_t fill(int fd);
-    ssize_t readEvent(input_event const** events);
-    void next();
+    InputEventRing() : mHead(0), mTail(0) { }
+
+    ssize_t fill(int fd) {
+        if (mHead == mTail) {
+            // nothing left over, start again so that the read doesn't wrap
+            mHead = mTail = 0;
+        }
+        // the free space, in two parts when it wraps, in one system call
+        const size_t index = mHead & (N - 1);
+        const size_t room = N - (mHead - mTail);
+        const size_t contiguous = room < N - index ? room : N - index;
+        ssize_t nread;
+        if (room == contiguous) {
+            nread = read(fd, &mBuffer[index], room * sizeof(input_event));
+        } else {
+            struct iovec iov[2];
+            iov[0].iov_base = &mBuffer[index];
+            iov[0].iov_len = contiguous * sizeof(input_event);
+            iov[1].iov_base = &mBuffer[0];
+            iov[1].iov_len = (room - contiguous) * sizeof(input_event);
+            nread = readv(fd, iov, 2);
+        }
+        if (nread<0 && errno == EAGAIN) {
+            // nothing queued, the driver was woken up for other reasons
+            return 0;
+        }
+        if (nread<0 || nread % sizeof(input_event)) {
+            // we got a partial event!!
+            return nread<0 ? -errno : -EINVAL;
+        }
+        mHead += nread / sizeof(input_event);
+        return nread / sizeof(input_event);
+    }
+
+    size_t span(input_event const** events) const {
+        const size_t index = mTail & (N - 1);
+        const size_t ready = mHead - mTail;
+        *events = &mBuffer[index];
+        return ready < N - index ? ready : N - index;
+    }
+
+    void consume(size_t numEvents) {
+        mTail += numEvents;
+    }
+
+    void clear() {
+        mHead = mTail = 0;
+    }
 };
 
 /*****************************************************************************/
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "PollPolicy.h"
+
+#ifndef PR_SET_TIMERSLACK
+#define PR_SET_TIMERSLACK 29
+#endif
+
+/*****************************************************************************/
+
+PollPolicy::PollPolicy()
+    : mFifoPriority(0),
+      mNice(0),
+      mHasNice(false),
+      mCpuMask(0),
+      mTimerSlackNs(-1),
+      mCoalesceUs(0),
+      mEmpty(true),
+      mApplied(false)
+{
+}
+
+void PollPolicy::load()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get(SENSORS_POLL_POLICY_PROPERTY, value, "");
+
+    char* saveptr;
+    for (char* token = strtok_r(value, ",", &saveptr) ; token ;
+            token = strtok_r(NULL, ",", &saveptr)) {
+        char* arg = strchr(token, '=');
+        if (!arg) {
+            ALOGE("%s: ignoring '%s'", SENSORS_POLL_POLICY_PROPERTY, token);
+            continue;
+        }
+        *arg++ = 0;
+        if (!strcmp(token, "fifo")) {
+            int prio = atoi(arg);
+            if (prio >= sched_get_priority_min(SCHED_FIFO) &&
+                    prio <= sched_get_priority_max(SCHED_FIFO)) {
+                mFifoPriority = prio;
+            } else {
+                ALOGE("%s: bad fifo priority %d", SENSORS_POLL_POLICY_PROPERTY, prio);
+            }
+        } else if (!strcmp(token, "nice")) {
+            mNice = atoi(arg);
+            mHasNice = true;
+        } else if (!strcmp(token, "cpus")) {
+            mCpuMask = strtoul(arg, NULL, 0);
+        } else if (!strcmp(token, "slack")) {
+            mTimerSlackNs = strtol(arg, NULL, 0);
+        } else if (!strcmp(token, "coalesce")) {
+            mCoalesceUs = strtol(arg, NULL, 0);
+        } else {
+            ALOGE("%s: unknown setting '%s'", SENSORS_POLL_POLICY_PROPERTY, token);
+        }
+    }
+
+    mEmpty = !mFifoPriority && !mHasNice && !mCpuMask && mTimerSlackNs < 0;
+    ALOGD_IF(!mEmpty, "poll policy: fifo=%d nice=%d cpus=0x%x slack=%ld",
+            mFifoPriority, mHasNice ? mNice : 0, mCpuMask, mTimerSlackNs);
+}
+
+/*
+ * Everything here acts on the calling thread only. Failures are logged
+ * and otherwise ignored, the sensors work the same without the policy.
+ */
+void PollPolicy::applySlow()
+{
+    mThread = pthread_self();
+    mApplied = true;
+
+    if (mFifoPriority) {
+        struct sched_param param;
+        param.sched_priority = mFifoPriority;
+        if (sched_setscheduler(0, SCHED_FIFO, &param)) {
+            ALOGE("couldn't set SCHED_FIFO %d (%s)", mFifoPriority, strerror(errno));
+        }
+    } else if (mHasNice) {
+        if (setpriority(PRIO_PROCESS, 0, mNice)) {
+            ALOGE("couldn't set nice %d (%s)", mNice, strerror(errno));
+        }
+    }
+
+    if (mCpuMask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu=0 ; cpu<32 ; cpu++) {
+            if (mCpuMask & (1u << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+            ALOGE("couldn't set affinity 0x%x (%s)", mCpuMask, strerror(errno));
+        }
+    }
+
+    if (mTimerSlackNs >= 0) {
+        if (prctl(PR_SET_TIMERSLACK, mTimerSlackNs, 0, 0, 0)) {
+            ALOGE("couldn't set timer slack %ld (%s)", mTimerSlackNs, strerror(errno));
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_POLL_POLICY_H
+#define ANDROID_POLL_POLICY_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Scheduling policy for the thread calling pollEvents(), read once when
+ * the device is opened, e.g.
+ *
+ *   setprop persist.sensors.poll.policy fifo=2,cpus=0x2,slack=50000
+ *
+ *   fifo=<prio>    SCHED_FIFO at that priority
+ *   nice=<n>       otherwise SCHED_OTHER at that nice level
+ *   cpus=<mask>    CPU affinity
+ *   slack=<ns>     timer slack, the kernel default is 50us
+ *   coalesce=<us>  granularity of the HAL's own deadlines, see TimerWheel
+ *
+ * The thread is owned by the framework, so the policy is applied from
+ * pollEvents() the first time a given thread calls it.
+ */
+#define SENSORS_POLL_POLICY_PROPERTY "persist.sensors.poll.policy"
+
+class PollPolicy {
+public:
+            PollPolicy();
+
+    void load();
+    // 0 for the TimerWheel default
+    int64_t getCoalesceNs() const { return mCoalesceUs * 1000LL; }
+    void apply() {
+        if (mEmpty || (mApplied && pthread_equal(mThread, pthread_self())))
+            return;
+        applySlow();
+    }
+
+private:
+    void applySlow();
+
+    int mFifoPriority;          // 0 = leave the policy alone
+    int mNice;
+    bool mHasNice;
+    uint32_t mCpuMask;          // 0 = leave the affinity alone
+    long mTimerSlackNs;         // <0 = leave the slack alone
+    long mCoalesceUs;
+    bool mEmpty;
+    bool mApplied;
+    pthread_t mThread;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_POLL_POLICY_H
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cutils/log.h>
+
+#include "RateTable.h"
+
+/*****************************************************************************/
+
+RateTable::RateTable()
+    : mCount(0)
+{
+}
+
+bool RateTable::load(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return false;
+
+    mCount = 0;
+    int delayMs;
+    long long periodUs;
+    while (mCount < MAX_RATES && fscanf(file, "%d %lld", &delayMs, &periodUs) == 2) {
+        add(delayMs, periodUs * 1000);
+    }
+    fclose(file);
+    return isValid();
+}
+
+bool RateTable::save(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        ALOGE("couldn't save rates to %s", path);
+        return false;
+    }
+    for (int i=0 ; i<mCount ; i++) {
+        fprintf(file, "%d %lld\n", mRates[i].delayMs, (long long)(mRates[i].periodNs / 1000));
+    }
+    return fclose(file) == 0;
+}
+
+void RateTable::add(int delayMs, int64_t periodNs)
+{
+    // a delay that delivered nothing is of no use
+    if (periodNs <= 0 || mCount == MAX_RATES)
+        return;
+    mRates[mCount].delayMs = delayMs;
+    mRates[mCount].periodNs = periodNs;
+    mCount++;
+}
+
+/*
+ * The slowest rate still at least as fast as requested, give or take
+ * 1/8th for jitter, the fastest one if none is. Of delays delivering the
+ * same rate the longest wins, it keeps the bus quietest.
+ */
+int RateTable::snap(int64_t ns, int64_t* periodNs) const
+{
+    int best = -1;
+    int fastest = -1;
+    for (int i=0 ; i<mCount ; i++) {
+        const rate_t& r(mRates[i]);
+        if (fastest < 0 || r.periodNs < mRates[fastest].periodNs) {
+            fastest = i;
+        }
+        if (r.periodNs > ns + ns / 8)
+            continue;
+        if (best < 0 || r.periodNs > mRates[best].periodNs ||
+                (r.periodNs == mRates[best].periodNs && r.delayMs > mRates[best].delayMs)) {
+            best = i;
+        }
+    }
+    if (best < 0) {
+        best = fastest;
+    }
+    if (best < 0) {
+        // nothing measured, trust the driver
+        *periodNs = ns;
+        return int(ns / 1000000);
+    }
+    *periodNs = mRates[best].periodNs;
+    return mRates[best].delayMs;
+}
+
+int64_t RateTable::getMinPeriod() const
+{
+    int64_t min = 0;
+    for (int i=0 ; i<mCount ; i++) {
+        if (!min || mRates[i].periodNs < min) {
+            min = mRates[i].periodNs;
+        }
+    }
+    return min;
+}
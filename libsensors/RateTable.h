@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_RATE_TABLE_H
+#define ANDROID_RATE_TABLE_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * The sample period a driver actually delivers for each of the delays
+ * that can be written to it, measured once and kept in a small text file
+ * of "<delay ms> <period us>" lines, so requests can be mapped to a delay
+ * that really provides them.
+ */
+class RateTable {
+public:
+    enum {
+        MAX_RATES = 8,
+        PROBE_SAMPLES = 5,      // intervals averaged per delay
+        // a delay that delivered nothing after this many periods, at
+        // least the minimum, delivers nothing: the first sample may still
+        // come at the previous delay, then half the rate is room enough
+        PROBE_TIMEOUT_PERIODS = 2 * (PROBE_SAMPLES + 2),
+        PROBE_TIMEOUT_MIN_MS = 500,
+    };
+
+            RateTable();
+
+    bool load(const char* path);
+    bool save(const char* path) const;
+    bool isValid() const { return mCount > 0; }
+
+    // Records the measured period for a delay, 0 if it delivered nothing.
+    void add(int delayMs, int64_t periodNs);
+    void clear() { mCount = 0; }
+
+    // The delay to write for a requested period, and what it delivers.
+    int snap(int64_t ns, int64_t* periodNs) const;
+    int64_t getMinPeriod() const;
+
+private:
+    struct rate_t {
+        int delayMs;
+        int64_t periodNs;
+    };
+    rate_t mRates[MAX_RATES];
+    int mCount;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_RATE_TABLE_H
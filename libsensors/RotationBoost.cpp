@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+
+#include "RotationBoost.h"
+#include "SensorTrace.h"
+
+/*****************************************************************************/
+
+// how long rotations took to come to rest, boosted or not
+struct settle_stats_t {
+    uint32_t settled;
+    int64_t leadNs;             // summed over the settled rotations
+    int64_t maxLeadNs;
+};
+
+// process-wide, drivers come and go
+static struct {
+    uint32_t rotations;
+    uint32_t boosts;
+    uint32_t limited;
+    uint32_t off;
+    uint32_t reverted;
+    settle_stats_t boosted;
+    settle_stats_t unboosted;
+} sStats;
+
+RotationBoost::RotationBoost()
+    : mEnabled(false),
+      mFd(-1),
+      mFailed(false),
+      mLastBoost(0),
+      mLastRotation(0),
+      mBoosted(false)
+{
+    reset();
+}
+
+RotationBoost::~RotationBoost()
+{
+    if (mFd >= 0) {
+        close(mFd);
+    }
+}
+
+void RotationBoost::reset()
+{
+    memset(mLast, 0, sizeof(mLast));
+    mCurrent = -1;
+    mPrevious = -1;
+    mCandidate = -1;
+    mCandidateSince = 0;
+    mLastChange = 0;
+    mSettling = false;
+    mStillSince = 0;
+}
+
+/*
+ * 0 to 3 counter-clockwise from upright, in the axes the events are
+ * reported in, or -1 when no axis dominates by 60 degrees or the device
+ * is too flat to tell.
+ */
+int RotationBoost::quadrant(const int* raw)
+{
+    // same mapping as BMA250Sensor::processEvent()
+    const int x = -raw[1];
+    const int y = raw[0];
+
+    if (x*x + y*y < TILT_LSB * TILT_LSB)
+        return -1;
+    // tan(60) ~ 7/4
+    if (4 * abs(y) > 7 * abs(x))
+        return y > 0 ? 0 : 2;
+    if (4 * abs(x) > 7 * abs(y))
+        return x > 0 ? 1 : 3;
+    return -1;
+}
+
+void RotationBoost::addSample(const int* raw, int64_t timestamp)
+{
+    if (mSettling) {
+        settle(raw, timestamp);
+    }
+    memcpy(mLast, raw, sizeof(mLast));
+
+    const int q = quadrant(raw);
+    if (q < 0 || q == mCurrent) {
+        mCandidate = -1;
+        return;
+    }
+    if (mCurrent < 0) {
+        // the first reading, nothing rotated
+        mCurrent = q;
+        return;
+    }
+    if (q != mCandidate) {
+        mCandidate = q;
+        mCandidateSince = timestamp;
+        return;
+    }
+    if (timestamp - mCandidateSince < CONFIRM_MS * 1000000LL)
+        return;
+
+    if (q == mPrevious && timestamp - mLastChange < REVERT_MS * 1000000LL) {
+        sStats.reverted++;
+    }
+    mPrevious = mCurrent;
+    mCurrent = q;
+    mCandidate = -1;
+    mLastChange = timestamp;
+    SENSOR_TRACE_INT("bma250 rotation", q);
+    sStats.rotations++;
+    mBoosted = boost(timestamp);
+    mLastRotation = timestamp;
+    mSettling = true;
+    mStillSince = 0;
+}
+
+/*
+ * The file descriptor stays open for the life of the driver, a boost is
+ * a single write at offset 0. Returns whether the CPU was boosted.
+ */
+bool RotationBoost::boost(int64_t timestamp)
+{
+    if (!mEnabled) {
+        sStats.off++;
+        return false;
+    }
+    if (mLastBoost && timestamp - mLastBoost < MIN_INTERVAL_MS * 1000000LL) {
+        sStats.limited++;
+        return false;
+    }
+    if (mFd < 0) {
+        if (mFailed)
+            return false;
+        mFd = open(BOOST_CPUFREQ_FILE, O_WRONLY);
+        if (mFd < 0) {
+            ALOGE("couldn't open %s (%s)", BOOST_CPUFREQ_FILE, strerror(errno));
+            mFailed = true;
+            return false;
+        }
+    }
+
+    if (pwrite(mFd, "1\n", 2, 0) != 2) {
+        ALOGE("couldn't write %s (%s)", BOOST_CPUFREQ_FILE, strerror(errno));
+        return false;
+    }
+    sStats.boosts++;
+    mLastBoost = timestamp;
+    return true;
+}
+
+void RotationBoost::settle(const int* raw, int64_t timestamp)
+{
+    int jerk = 0;
+    for (int i=0 ; i<3 ; i++) {
+        jerk += abs(raw[i] - mLast[i]);
+    }
+    if (jerk > QUIET_LSB) {
+        mStillSince = 0;
+        return;
+    }
+    if (!mStillSince) {
+        mStillSince = timestamp;
+        return;
+    }
+    if (timestamp - mStillSince < SETTLE_MS * 1000000LL)
+        return;
+
+    settle_stats_t& stats(mBoosted ? sStats.boosted : sStats.unboosted);
+    const int64_t lead = mStillSince - mLastRotation;
+    stats.settled++;
+    stats.leadNs += lead;
+    if (lead > stats.maxLeadNs) {
+        stats.maxLeadNs = lead;
+    }
+    mSettling = false;
+}
+
+static void dumpSettle(FILE* file, const char* what, settle_stats_t const& stats)
+{
+    fprintf(file, "# %s rotations at rest %lldms after the prediction on average, "
+            "%lldms at most, over %u\n", what,
+            (long long)(stats.settled ? stats.leadNs / stats.settled / 1000000 : 0),
+            (long long)(stats.maxLeadNs / 1000000), stats.settled);
+}
+
+void RotationBoost::dumpStats(FILE* file)
+{
+    if (!sStats.rotations)
+        return;
+    fprintf(file, "# rotations %u, boosted %u, not boosted %u (rate limited %u, "
+            "boost off %u), reverted %u\n",
+            sStats.rotations, sStats.boosts, sStats.rotations - sStats.boosts,
+            sStats.limited, sStats.off, sStats.reverted);
+    dumpSettle(file, "boosted", sStats.boosted);
+    dumpSettle(file, "other", sStats.unboosted);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ROTATION_BOOST_H
+#define ANDROID_ROTATION_BOOST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include "nusensors.h"
+
+// owned by system, see init.otter-common.rc; a write boosts for 3s
+#define BOOST_CPUFREQ_FILE SENSORS_ROOT "/sys/devices/system/cpu/cpu0/cpufreq/boost_cpufreq"
+
+/*****************************************************************************/
+
+/*
+ * Boosts the CPU as soon as the accelerometer suggests the screen is about
+ * to rotate, so the relayout that follows doesn't start at whatever low
+ * frequency ondemand had settled on. A probable rotation is the gravity
+ * vector in the screen plane leaving its quadrant by more than 15 degrees
+ * for CONFIRM_MS, well before the framework's own filter decides. Boosts
+ * are at least MIN_INTERVAL_MS apart, the length of one boost, so a
+ * device jiggling on the edge of two quadrants can't keep the CPU up.
+ *
+ * Rotations are followed with the boost off as well, so the figures can
+ * be compared. The counters are kept for the life of the process and end
+ * up in the sensors stats file: rotations, those boosted and those not,
+ * rate limited or with the boost off, predictions taken back within
+ * REVERT_MS, and how long after the prediction the device came to rest,
+ * for the boosted and the other rotations apart. For the boosted ones
+ * that is the head start the boost had on the framework.
+ */
+class RotationBoost {
+public:
+    enum {
+        TILT_LSB = 128,         // 0.5g in the screen plane, flatter has no orientation
+        CONFIRM_MS = 60,
+        MIN_INTERVAL_MS = 3000,
+        REVERT_MS = 1500,
+        QUIET_LSB = 12,         // jerk of a device at rest
+        SETTLE_MS = 100,
+    };
+
+            RotationBoost();
+            ~RotationBoost();
+
+    // Whether rotations boost the CPU or are only counted.
+    void setEnabled(bool enabled) { mEnabled = enabled; }
+    // Forgets the orientation, the boost file and the counters are kept.
+    void reset();
+    void addSample(const int* raw, int64_t timestamp);
+
+    static void dumpStats(FILE* file);
+
+private:
+    bool mEnabled;
+    int mFd;
+    bool mFailed;               // the boost file can't be written
+    int mLast[3];
+    int mCurrent;               // quadrant, -1 while unknown
+    int mPrevious;
+    int mCandidate;
+    int64_t mCandidateSince;
+    int64_t mLastChange;
+    int64_t mLastBoost;
+    int64_t mLastRotation;
+    bool mBoosted;              // the last rotation was
+    bool mSettling;
+    int64_t mStillSince;
+
+    static int quadrant(const int* raw);
+    bool boost(int64_t timestamp);
+    void settle(const int* raw, int64_t timestamp);
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_ROTATION_BOOST_H
@@ -26,23 +26,70 @@
 #include <cutils/log.h>
 
 #include "STK-ALS22x7.h"
+#include "SensorTrace.h"
 
 #define TAG "STK-ALS-22x7"
 
-STK_ALS22x7Sensor::STK_ALS22x7Sensor()
+STK_ALS22x7Sensor::STK_ALS22x7Sensor(SensorArbiter* arbiter)
 : SensorBase(DEVICE_NAME, "lightsensor-level"),
-      mInputReader(32)
+  mArbiter(arbiter)
 {
     mPendingEvent.version = sizeof(sensors_event_t);
     mPendingEvent.sensor = ID_B;
     mPendingEvent.type = SENSOR_TYPE_LIGHT;
     memset(mPendingEvent.data, 0, sizeof(mPendingEvent.data));
+
+    mEnabled = false;
+    // this instance's wish, the node may be on for another one
+    mHwEnabled = false;
+    mHasDelayNode = !access(STK_ALS22X7_DELAY_FILE, W_OK);
+    mArbiter->attach(SensorArbiter::ALS22X7, STK_ALS22X7_ENABLE_FILE,
+            mHasDelayNode ? STK_ALS22X7_DELAY_FILE : NULL);
+    mState = OFF;
+    mDelayNs = 0;
+    mDeadline = 0;
+    ALOGD_IF(!mHasDelayNode, TAG ": no delay node, rates slower than %dms are duty-cycled",
+            DUTY_CYCLE_MS);
 }
 
 STK_ALS22x7Sensor::~STK_ALS22x7Sensor() {
 }
 
+size_t STK_ALS22x7Sensor::arenaSize()
+{
+    return SensorArena::align(sizeof(STK_ALS22x7Sensor));
+}
+
 int STK_ALS22x7Sensor::enable(int32_t handle, int en)
+{
+    bool enabled = en ? true : false;
+
+    // don't set enable state if it's already valid
+    if (mEnabled == enabled) {
+        return 0;
+    }
+
+    mEnabled = enabled;
+    int err = updateMode();
+    if (err) {
+        mEnabled = !enabled;
+    }
+    return err;
+}
+
+int STK_ALS22x7Sensor::setDelay(int32_t handle, int64_t ns)
+{
+    if (ns < 0)
+        return -EINVAL;
+
+    mDelayNs = ns;
+    if (mEnabled) {
+        return updateMode();
+    }
+    return 0;
+}
+
+int STK_ALS22x7Sensor::writeEnable(int en)
 {
     int err = 0;
 
@@ -51,26 +98,107 @@ int STK_ALS22x7Sensor::enable(int32_t handle, int en)
     // ALOGD(TAG ": Setting enable: %d", en);
 
     // don't set enable state if it's already valid
-    if (isEnabled() == newState) {
+    if (mHwEnabled == newState) {
         return err;
     }
 
-    int fd = open(STK_ALS22X7_ENABLE_FILE, O_WRONLY);
-    if(fd >= 0) {
-        char buffer[20];
-        int bytes = sprintf(buffer, "%d\n", newState);
-        err = write(fd, buffer, bytes);
-        err = err < 0 ? -errno : 0;
-        close(fd);
-    } else {
-        err = -errno;
-    }
+    err = mArbiter->setEnable(SensorArbiter::ALS22X7, newState);
 
     ALOGE_IF(err < 0, TAG ": Error setting enable of stk-als-22x7 light sensor (%s)", strerror(-err));
+    if (!err) {
+        mHwEnabled = newState;
+    }
+
+    return err;
+}
+
+int STK_ALS22x7Sensor::writeDelay(unsigned long delay)
+{
+    int err = mArbiter->setDelay(SensorArbiter::ALS22X7, delay);
+
+    ALOGE_IF(err < 0, TAG ": Error setting delay of stk-als-22x7 light sensor (%s)", strerror(-err));
 
     return err;
 }
 
+/*
+ * With a delay node the driver paces itself. Without one, requests slower
+ * than DUTY_CYCLE_MS power the sensor up for a WINDOW_MS window once per
+ * period and down again as soon as a sample came in; the poll loop wakes
+ * us for the window edges through getDeadline().
+ *
+ * Returns the error of the enable node, the mode is left as it was then.
+ */
+int STK_ALS22x7Sensor::updateMode()
+{
+    int err;
+
+    if (!mEnabled) {
+        err = writeEnable(0);
+        if (!err) {
+            mState = OFF;
+        }
+        return err;
+    }
+
+    if (mHasDelayNode) {
+        writeDelay(mDelayNs / 1000000);
+    }
+
+    if (mHasDelayNode || mDelayNs < DUTY_CYCLE_MS * 1000000LL) {
+        err = writeEnable(1);
+        if (!err) {
+            mState = CONTINUOUS;
+        }
+        return err;
+    }
+
+    if (mState != SLEEPING && mState != SAMPLING) {
+        // first value as soon as possible, the new period applies after it
+        err = startWindow(getTimestamp());
+        if (err) {
+            mState = OFF;
+        }
+        return err;
+    }
+    return 0;
+}
+
+/*
+ * A window that failed to power the sensor up still runs its course, the
+ * next one tries again.
+ */
+int STK_ALS22x7Sensor::startWindow(int64_t now)
+{
+    int err = writeEnable(1);
+    mState = SAMPLING;
+    mDeadline = now + WINDOW_MS * 1000000LL;
+    return err;
+}
+
+void STK_ALS22x7Sensor::endWindow()
+{
+    writeEnable(0);
+    mState = SLEEPING;
+    // the period runs from the start of the window
+    mDeadline += mDelayNs - WINDOW_MS * 1000000LL;
+    int64_t now = getTimestamp();
+    if (mDeadline < now) {
+        mDeadline = now;
+    }
+}
+
+bool STK_ALS22x7Sensor::hasPendingEvents() const
+{
+    return (mState == SLEEPING || mState == SAMPLING) && getTimestamp() >= mDeadline;
+}
+
+int64_t STK_ALS22x7Sensor::getDeadline() const
+{
+    if (mState != SLEEPING && mState != SAMPLING)
+        return 0;
+    return mDeadline;
+}
 
 int STK_ALS22x7Sensor::readEvents(sensors_event_t* data, int count)
 {
@@ -80,32 +208,70 @@ int STK_ALS22x7Sensor::readEvents(sensors_event_t* data, int count)
         return -EINVAL;
     }
 
+    if (mState == SLEEPING || mState == SAMPLING) {
+        int64_t now = getTimestamp();
+        if (now >= mDeadline) {
+            // evdev drops unchanged values, so a quiet window is normal
+            if (mState == SLEEPING) {
+                startWindow(now);
+            } else {
+                endWindow();
+            }
+        }
+    }
+
     ssize_t n = mInputReader.fill(data_fd);
+    SENSOR_TRACE_INT("als22x7 fill", n);
     if (n < 0) {
         return n;
     }
 
     int numEventReceived = 0;
-    input_event const* event;
-
-    while (count && mInputReader.readEvent(&event)) {
-        // ALOGD(TAG ": event (type=0x%x, code=0x%x, value=0x%x)", event->type, event->code, event->value);
-        switch (event->type) {
-            case EV_ABS:
-                processEvent(event->code, event->value);
-                break;
-            case EV_SYN:
-                mPendingEvent.timestamp = timevalToNano(event->time);
-                *data++ = mPendingEvent;
-                count--;
-                numEventReceived++;
-                break;
-            default:
-                ALOGW(TAG ": unknown event (type=0x%x, code=0x%x, value=0x%x)",
-                        event->type, event->code, event->value);
-                break;
+    input_event const* events;
+    size_t ready;
+
+    while (count && (ready = mInputReader.span(&events))) {
+        size_t i = 0;
+        for ( ; count && i < ready ; i++) {
+            input_event const* event = &events[i];
+            // ALOGD(TAG ": event (type=0x%x, code=0x%x, value=0x%x)", event->type, event->code, event->value);
+            switch (event->type) {
+                case EV_ABS:
+                    if (!mDropping) {
+                        processEvent(event->code, event->value);
+                    }
+                    break;
+                case EV_SYN: {
+                    int frame = checkSyn(event);
+                    if (frame == FRAME_SKIP)
+                        break;
+                    if (frame == FRAME_RESYNC) {
+                        int value;
+                        if (!getAbsValue(ABS_MISC, &value)) {
+                            processEvent(ABS_MISC, value);
+                        }
+                        SENSOR_TRACE_INT("als22x7 dropped", mDropped);
+                    }
+                    if (mState == SLEEPING || mState == OFF) {
+                        // left over from the last window
+                        break;
+                    }
+                    mPendingEvent.timestamp = timevalToNano(event->time);
+                    *data++ = mPendingEvent;
+                    count--;
+                    numEventReceived++;
+                    if (mState == SAMPLING) {
+                        endWindow();
+                    }
+                    break;
+                }
+                default:
+                    ALOGW(TAG ": unknown event (type=0x%x, code=0x%x, value=0x%x)",
+                            event->type, event->code, event->value);
+                    break;
+            }
         }
-        mInputReader.next();
+        mInputReader.consume(i);
     }
 
     return numEventReceived;
@@ -124,23 +290,3 @@ void STK_ALS22x7Sensor::processEvent(int code, int value)
             break;
     }
 }
-
-int STK_ALS22x7Sensor::isEnabled()
-{
-    int ret = 0;
-    int fd = open(STK_ALS22X7_ENABLE_FILE, O_RDONLY);
-    if (fd >= 0) {
-        char buffer[20];
-        int amt = read(fd, buffer, 20);
-        close(fd);
-        if(amt > 0) {
-            ret = (buffer[0] == '1');
-        } else {
-            ALOGE(TAG ": isEnable failed to read (%s)", strerror(errno));
-        }
-    } else {
-        ALOGE(TAG ": isEnabled failed to open %s", STK_ALS22X7_ENABLE_FILE);
-    }
-    // ALOGD(TAG ": isEnabled == %d", ret);
-    return ret;
-}
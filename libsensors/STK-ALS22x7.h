@@ -27,25 +27,58 @@
 #include "nusensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "SensorArena.h"
+#include "SensorArbiter.h"
 
-#define STK_ALS22X7_ENABLE_FILE "/sys/bus/i2c/devices/4-0010/enable"
+#define STK_ALS22X7_ENABLE_FILE SENSORS_ROOT "/sys/bus/i2c/devices/4-0010/enable"
+// not every kernel has it, without it the HAL duty-cycles the sensor
+#define STK_ALS22X7_DELAY_FILE SENSORS_ROOT "/sys/bus/i2c/devices/4-0010/delay"
 
 struct input_event;
 
 class STK_ALS22x7Sensor : public SensorBase {
 public:
-    STK_ALS22x7Sensor();
+    STK_ALS22x7Sensor(SensorArbiter* arbiter);
     virtual ~STK_ALS22x7Sensor();
+    static size_t arenaSize();
 
     virtual int enable(int32_t handle, int enabled);
+    virtual int setDelay(int32_t handle, int64_t ns);
+    virtual bool hasPendingEvents() const;
+    virtual int64_t getDeadline() const;
     virtual int readEvents(sensors_event_t* data, int count);
     void processEvent(int code, int value);
 
 protected:
-    InputEventCircularReader mInputReader;
+    enum {
+        numInputEvents = 32,
+        DUTY_CYCLE_MS = 500,    // slower requests are duty-cycled
+        WINDOW_MS = 200,        // powered per cycle, a few integrations
+    };
+
+    // how the hardware is run while enabled
+    enum {
+        OFF,
+        CONTINUOUS,
+        SLEEPING,               // powered down until mDeadline
+        SAMPLING,               // powered up until a sample or mDeadline
+    };
+
+    SensorArbiter* mArbiter;
+    InputEventRing<numInputEvents> mInputReader;
     sensors_event_t mPendingEvent;
+    bool mEnabled;
+    bool mHwEnabled;
+    bool mHasDelayNode;
+    int mState;
+    int64_t mDelayNs;
+    int64_t mDeadline;
 
-    int isEnabled();
+    int writeEnable(int enabled);
+    int writeDelay(unsigned long delay);
+    int updateMode();
+    int startWindow(int64_t now);
+    void endWindow();
 };
 
 #endif  // ANDROID_STK_ALS22x7_SENSOR_H
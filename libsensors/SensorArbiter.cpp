@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <cutils/log.h>
+
+#include "SensorArbiter.h"
+
+#define ARBITER_MAGIC   0x53415232      // 'SAR2', bump when state_t changes
+
+/*****************************************************************************/
+
+static int64_t monotonicNow()
+{
+    struct timespec t;
+    t.tv_sec = t.tv_nsec = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+static int writeValue(const char* file, long value)
+{
+    int err = 0;
+    int fd = ::open(file, O_WRONLY);
+    if (fd >= 0) {
+        char buffer[20];
+        int bytes = sprintf(buffer, "%ld\n", value);
+        err = write(fd, buffer, bytes);
+        err = err < 0 ? -errno : 0;
+        close(fd);
+    } else {
+        err = -errno;
+    }
+    return err;
+}
+
+SensorArbiter::SensorArbiter()
+    : mState(&mLocal),
+      mSlot(&mLocal.slots[0]),
+      mFd(-1),
+      mOpened(false),
+      mPrimary(true)
+{
+    reset(&mLocal, "");
+    mLocal.slots[0].pid = getpid();
+    for (int part=0 ; part<NUM_PARTS ; part++) {
+        mEnableFile[part] = NULL;
+        mDelayFile[part] = NULL;
+    }
+}
+
+SensorArbiter::~SensorArbiter()
+{
+    if (mState == &mLocal)
+        return;
+
+    // leave the parts to whoever still wants them
+    lock();
+    share(monotonicNow());
+    for (int part=0 ; part<NUM_PARTS ; part++) {
+        mSlot->enabled[part] = 0;
+        if (mEnableFile[part]) {
+            program(part);
+        }
+    }
+    mSlot->pid = 0;
+    unlock();
+    munmap(mState, sizeof(state_t));
+    close(mFd);
+}
+
+void SensorArbiter::attach(int part, const char* enableFile, const char* delayFile)
+{
+    mEnableFile[part] = enableFile;
+    mDelayFile[part] = delayFile;
+}
+
+void SensorArbiter::reset(state_t* state, char const* bootId)
+{
+    memset(state, 0, sizeof(*state));
+    state->magic = ARBITER_MAGIC;
+    strncpy(state->bootId, bootId, sizeof(state->bootId) - 1);
+    for (int part=0 ; part<NUM_PARTS ; part++) {
+        state->enabled[part] = -1;
+        state->delayMs[part] = -1;
+    }
+    for (int i=0 ; i<MAX_INSTANCES ; i++) {
+        for (int part=0 ; part<NUM_PARTS ; part++) {
+            state->slots[i].delayMs[part] = -1;
+        }
+    }
+}
+
+/*
+ * On first use, from the poll thread: maps the shared file and claims a
+ * slot in it, carrying over what was recorded locally until then.
+ */
+void SensorArbiter::open()
+{
+    mOpened = true;
+
+    char bootId[40];
+    memset(bootId, 0, sizeof(bootId));
+    int fd = ::open(SENSOR_ARBITER_BOOT_ID_FILE, O_RDONLY);
+    if (fd >= 0) {
+        read(fd, bootId, sizeof(bootId) - 1);
+        close(fd);
+    }
+
+    fd = ::open(SENSOR_ARBITER_FILE, O_RDWR | O_CREAT, 0660);
+    if (fd < 0) {
+        ALOGE("couldn't open %s (%s), not sharing the sensors", SENSOR_ARBITER_FILE, strerror(errno));
+        return;
+    }
+    flock(fd, LOCK_EX);
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (!fstat(fd, &st) && (st.st_size == sizeof(state_t) || !ftruncate(fd, sizeof(state_t)))) {
+        base = mmap(NULL, sizeof(state_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (base == MAP_FAILED) {
+        ALOGE("couldn't map %s (%s), not sharing the sensors", SENSOR_ARBITER_FILE, strerror(errno));
+        flock(fd, LOCK_UN);
+        close(fd);
+        return;
+    }
+
+    state_t* state = static_cast<state_t*>(base);
+    if (state->magic != ARBITER_MAGIC || strcmp(state->bootId, bootId)) {
+        reset(state, bootId);
+    }
+    // close the local accounting, then the shared one to the same time
+    int64_t now = monotonicNow();
+    share(now);
+    mState = state;
+    reap();
+    share(now);
+    slot_t* slot = NULL;
+    for (int i=0 ; i<MAX_INSTANCES && !slot ; i++) {
+        if (!state->slots[i].pid) {
+            slot = &state->slots[i];
+        }
+    }
+    if (!slot) {
+        ALOGE("%s: no free slot, not sharing the sensors", SENSOR_ARBITER_FILE);
+        mState = &mLocal;
+        munmap(base, sizeof(state_t));
+        flock(fd, LOCK_UN);
+        close(fd);
+        return;
+    }
+    *slot = *mSlot;
+    mSlot = slot;
+    mFd = fd;
+    flock(fd, LOCK_UN);
+}
+
+void SensorArbiter::lock()
+{
+    if (!mOpened) {
+        open();
+    }
+    if (mFd >= 0) {
+        flock(mFd, LOCK_EX);
+        reap();
+    }
+}
+
+void SensorArbiter::unlock()
+{
+    if (mFd >= 0) {
+        flock(mFd, LOCK_UN);
+    }
+}
+
+/*
+ * With the lock held. A process that died without closing the HAL leaves
+ * its wishes behind; the parts it wanted are reprogrammed without them,
+ * as far as this instance knows their files.
+ */
+void SensorArbiter::reap()
+{
+    bool changed = false;
+    for (int i=0 ; i<MAX_INSTANCES ; i++) {
+        slot_t* slot = &mState->slots[i];
+        if (!slot->pid || slot == mSlot)
+            continue;
+        if (kill(slot->pid, 0) < 0 && errno == ESRCH) {
+            ALOGD("%s: reclaiming the slot of pid %d", SENSOR_ARBITER_FILE, slot->pid);
+            if (!changed) {
+                // the dead one's share runs up to now
+                share(monotonicNow());
+            }
+            memset(slot, 0, sizeof(*slot));
+            for (int part=0 ; part<NUM_PARTS ; part++) {
+                slot->delayMs[part] = -1;
+            }
+            changed = true;
+        }
+    }
+    for (int part=0 ; changed && part<NUM_PARTS ; part++) {
+        if (mEnableFile[part]) {
+            program(part);
+        }
+    }
+}
+
+/*
+ * With the lock held: splits the time since the last call evenly between
+ * the live instances that had a handle active, per handle.
+ */
+void SensorArbiter::share(int64_t now)
+{
+    int64_t elapsed = mState->sharedSince ? now - mState->sharedSince : 0;
+    mState->sharedSince = now;
+    if (elapsed <= 0)
+        return;
+
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        int users = 0;
+        for (int i=0 ; i<MAX_INSTANCES ; i++) {
+            slot_t const* slot = &mState->slots[i];
+            if (slot->pid && (slot->handles & (1 << h))) {
+                users++;
+            }
+        }
+        for (int i=0 ; users && i<MAX_INSTANCES ; i++) {
+            slot_t* slot = &mState->slots[i];
+            if (slot->pid && (slot->handles & (1 << h))) {
+                slot->shareNs[h] += elapsed / users;
+            }
+        }
+    }
+}
+
+/*
+ * With the lock held: writes what the live instances want together, when
+ * it differs from what was last programmed. The record is only updated
+ * once a write went through, so a failed one is tried again next time.
+ */
+int SensorArbiter::program(int part)
+{
+    bool enabled = false;
+    int32_t delayMs = -1;
+    for (int i=0 ; i<MAX_INSTANCES ; i++) {
+        slot_t const* slot = &mState->slots[i];
+        if (!slot->pid || !slot->enabled[part])
+            continue;
+        enabled = true;
+        if (slot->delayMs[part] >= 0 && (delayMs < 0 || slot->delayMs[part] < delayMs)) {
+            delayMs = slot->delayMs[part];
+        }
+    }
+
+    int err = 0;
+    if (mState->enabled[part] != int32_t(enabled)) {
+        err = writeValue(mEnableFile[part], enabled);
+        if (err)
+            return err;
+        mState->enabled[part] = enabled;
+        if (!enabled) {
+            // the delay is written again on the next enable, as it always was
+            mState->delayMs[part] = -1;
+        }
+    }
+    if (enabled && delayMs >= 0 && mDelayFile[part] && mState->delayMs[part] != delayMs) {
+        err = writeValue(mDelayFile[part], delayMs);
+        if (!err) {
+            mState->delayMs[part] = delayMs;
+        }
+    }
+    return err;
+}
+
+int SensorArbiter::setEnable(int part, int enabled)
+{
+    lock();
+    int32_t previous = mSlot->enabled[part];
+    mSlot->enabled[part] = enabled ? 1 : 0;
+    int err = program(part);
+    if (err && enabled) {
+        // not running for us, don't keep it up for us later either
+        mSlot->enabled[part] = previous;
+    }
+    unlock();
+    return err;
+}
+
+int SensorArbiter::setDelay(int part, unsigned long ms)
+{
+    lock();
+    mSlot->delayMs[part] = ms > 0x7fffffff ? 0x7fffffff : int32_t(ms);
+    int err = program(part);
+    unlock();
+    return err;
+}
+
+int SensorArbiter::restart(int part)
+{
+    lock();
+    int err = writeValue(mEnableFile[part], 0);
+    if (!err) {
+        mState->enabled[part] = 0;
+        mState->delayMs[part] = -1;
+        err = program(part);
+    }
+    unlock();
+    return err;
+}
+
+bool SensorArbiter::isUsedElsewhere(int part)
+{
+    bool used = false;
+    lock();
+    for (int i=0 ; i<MAX_INSTANCES ; i++) {
+        slot_t const* slot = &mState->slots[i];
+        if (slot != mSlot && slot->pid && slot->enabled[part]) {
+            used = true;
+        }
+    }
+    unlock();
+    return used;
+}
+
+void SensorArbiter::setActive(int32_t handles)
+{
+    lock();
+    share(monotonicNow());
+    mSlot->handles = handles;
+    unlock();
+}
+
+void SensorArbiter::getShares(int64_t* shareNs)
+{
+    lock();
+    share(monotonicNow());
+    memcpy(shareNs, mSlot->shareNs, sizeof(mSlot->shareNs));
+    unlock();
+}
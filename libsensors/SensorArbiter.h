@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_ARBITER_H
+#define ANDROID_SENSOR_ARBITER_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include "nusensors.h"
+
+/*****************************************************************************/
+
+/*
+ * The framework and sensorhubd each open the HAL, and both would program
+ * the same enable and delay nodes. Every instance instead records what it
+ * wants in a slot of a small file shared between them, and whichever
+ * changes its wishes programs the parts with what all live instances
+ * want together: enabled if any is, at the shortest delay asked for.
+ * Updates are serialized with flock(); slots of dead processes are
+ * reclaimed on the next update. Without the file, e.g. before /data is
+ * mounted, an instance only arbitrates between its own requests.
+ *
+ * The slots also record which handles each instance has active, so the
+ * time a handle is active in several processes is split between them
+ * rather than billed to each in full, see SensorStats.
+ */
+#define SENSOR_ARBITER_FILE SENSORS_ROOT "/data/system/sensors.arbiter"
+// the programmed state in the file means nothing after a reboot
+#define SENSOR_ARBITER_BOOT_ID_FILE "/proc/sys/kernel/random/boot_id"
+
+class SensorArbiter {
+public:
+    enum {
+        BMA250,
+        ALS22X7,
+        NUM_PARTS,
+        MAX_INSTANCES = 4,
+        MAX_HANDLES = 32,
+    };
+
+            SensorArbiter();
+            ~SensorArbiter();
+
+    // the framework's instance; only it acts on the rest of the system
+    void setPrimary(bool primary) { mPrimary = primary; }
+    bool isPrimary() const { return mPrimary; }
+
+    // delayFile may be NULL for a part without one
+    void attach(int part, const char* enableFile, const char* delayFile);
+
+    // Record this instance's wishes and program the part. 0 or -errno.
+    int setEnable(int part, int enabled);
+    int setDelay(int part, unsigned long ms);
+    // Power cycles the part and programs it again, for recover().
+    int restart(int part);
+    // Whether another live instance has the part enabled.
+    bool isUsedElsewhere(int part);
+    // Records the handles this instance has active, one bit each.
+    void setActive(int32_t handles);
+    // This instance's share of the time each handle was active, in ns.
+    void getShares(int64_t* shareNs);
+
+private:
+    struct slot_t {
+        int32_t pid;            // 0 when free
+        int32_t enabled[NUM_PARTS];
+        int32_t delayMs[NUM_PARTS];     // -1 if never set
+        int32_t handles;                // active, one bit each
+        int64_t shareNs[MAX_HANDLES];
+    };
+
+    struct state_t {
+        uint32_t magic;
+        char bootId[40];
+        int32_t enabled[NUM_PARTS];     // as last programmed, -1 if unknown
+        int32_t delayMs[NUM_PARTS];
+        int64_t sharedSince;            // monotonic, shareNs are up to here
+        slot_t slots[MAX_INSTANCES];
+    };
+
+    void lock();
+    void unlock();
+    void open();
+    void reset(state_t* state, char const* bootId);
+    void reap();
+    void share(int64_t now);
+    int program(int part);
+
+    state_t* mState;            // the shared file, or mLocal
+    slot_t* mSlot;
+    state_t mLocal;
+    int mFd;
+    bool mOpened;
+    bool mPrimary;
+    const char* mEnableFile[NUM_PARTS];
+    const char* mDelayFile[NUM_PARTS];
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_ARBITER_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_ARENA_H
+#define ANDROID_SENSOR_ARENA_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <cutils/log.h>
+
+/*****************************************************************************/
+
+/*
+ * Bump allocator over the single block allocated in open_sensors. The
+ * poll context, every driver and every driver buffer are carved from it,
+ * each on its own cache lines, so no two drivers ever share a line and
+ * reading, filtering and delivering events never touches the heap.
+ * Nothing is freed individually, the whole block goes away on close.
+ */
+class SensorArena {
+public:
+    enum {
+        CACHE_LINE = 32,        // Cortex-A9 L1 and PL310 L2 line size
+    };
+
+    static size_t align(size_t size) {
+        return (size + CACHE_LINE - 1) & ~size_t(CACHE_LINE - 1);
+    }
+
+    SensorArena(void* base, size_t size)
+        : mBase(static_cast<char*>(base)), mSize(size), mUsed(0) { }
+
+    void* alloc(size_t size) {
+        size = align(size);
+        LOG_ALWAYS_FATAL_IF(mUsed + size > mSize,
+                "sensor arena exhausted (%zu + %zu > %zu)", mUsed, size, mSize);
+        void* p = mBase + mUsed;
+        mUsed += size;
+        return p;
+    }
+
+private:
+    char* const mBase;
+    const size_t mSize;
+    size_t mUsed;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_ARENA_H
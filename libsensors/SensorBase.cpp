@@ -20,12 +20,14 @@
 #include <poll.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <sys/ioctl.h>
 #include <sys/select.h>
 
 #include <cutils/log.h>
 
 #include <linux/input.h>
 
+#include "nusensors.h"
 #include "SensorBase.h"
 
 /*****************************************************************************/
@@ -34,7 +36,8 @@ SensorBase::SensorBase(
         const char* dev_name,
         const char* data_name)
     : dev_name(dev_name), data_name(data_name),
-      dev_fd(-1), data_fd(-1)
+      dev_fd(-1), data_fd(-1),
+      mDropping(false), mDropped(0)
 {
     data_fd = openInput(data_name);
 }
@@ -64,6 +67,52 @@ int SensorBase::close_device() {
     return 0;
 }
 
+/*
+ * After SYN_DROPPED the kernel has thrown events away: whatever comes up
+ * to the next SYN_REPORT is an incomplete frame, to be ignored, and the
+ * driver must then read its axes back from the device before reporting.
+ */
+int SensorBase::checkSyn(input_event const* event) {
+    switch (event->code) {
+        case SYN_REPORT:
+            if (mDropping) {
+                mDropping = false;
+                return FRAME_RESYNC;
+            }
+            return FRAME_READY;
+        case SYN_DROPPED:
+            mDropping = true;
+            mDropped++;
+            ALOGW("%s: input queue overflow, %u so far", data_name, mDropped);
+            break;
+    }
+    return FRAME_SKIP;
+}
+
+int SensorBase::getAbsValue(int code, int* value) const {
+    struct input_absinfo info;
+    if (ioctl(data_fd, EVIOCGABS(code), &info) < 0) {
+        int err = -errno;
+        ALOGE("%s: EVIOCGABS(%d) failed (%s)", data_name, code, strerror(-err));
+        return err;
+    }
+    *value = info.value;
+    return 0;
+}
+
+/*
+ * For recover(): a wedged input device sometimes only comes back once
+ * reopened. Returns the new fd, or -errno.
+ */
+int SensorBase::reopenInput() {
+    if (data_fd >= 0) {
+        close(data_fd);
+    }
+    data_fd = openInput(data_name);
+    mDropping = false;
+    return data_fd < 0 ? -ENODEV : data_fd;
+}
+
 int SensorBase::getFd() const {
     return data_fd;
 }
@@ -72,10 +121,51 @@ int SensorBase::setDelay(int32_t handle, int64_t ns) {
     return 0;
 }
 
+/*
+ * How long events may be held back before delivery, 0 for none. Only
+ * drivers that batch override this.
+ */
+int SensorBase::setBatchTimeout(int32_t handle, int64_t ns) {
+    return 0;
+}
+
 bool SensorBase::hasPendingEvents() const {
     return false;
 }
 
+/*
+ * When, in getTimestamp() time, the driver wants readEvents() called again
+ * even if its fd stays quiet, or 0 if it only reacts to input.
+ */
+int64_t SensorBase::getDeadline() const {
+    return 0;
+}
+
+/*
+ * Whether the driver may be destroyed while none of its handles is
+ * enabled, i.e. it keeps no state that must outlive an activation.
+ */
+bool SensorBase::canRelease() const {
+    return true;
+}
+
+/*
+ * The period the hardware is programmed to deliver input at, 0 when the
+ * driver is idle or its input only comes on change, which also keeps it
+ * off the stall watchdog in nusensors.cpp.
+ */
+int64_t SensorBase::getWatchdogPeriod() const {
+    return 0;
+}
+
+/*
+ * Called by the watchdog when input stopped for many periods: restart
+ * the hardware and the input device. The fd may change.
+ */
+int SensorBase::recover() {
+    return -ENOSYS;
+}
+
 int64_t SensorBase::getTimestamp() {
     struct timespec t;
     t.tv_sec = t.tv_nsec = 0;
@@ -85,7 +175,7 @@ int64_t SensorBase::getTimestamp() {
 
 int SensorBase::openInput(const char* inputName) {
     int fd = -1;
-    const char *dirname = "/dev/input";
+    const char *dirname = SENSORS_ROOT "/dev/input";
     char devname[PATH_MAX];
     char *filename;
     DIR *dir;
@@ -102,11 +192,13 @@ int SensorBase::openInput(const char* inputName) {
                         (de->d_name[1] == '.' && de->d_name[2] == '\0')))
             continue;
         strcpy(filename, de->d_name);
-        fd = open(devname, O_RDONLY);
+        fd = open(devname, O_RDONLY | O_NONBLOCK);
         if (fd>=0) {
             char name[80];
             if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), &name) < 1) {
-                name[0] = '\0';
+                // not an input device: a host stand-in, named after the device
+                strncpy(name, de->d_name, sizeof(name) - 1);
+                name[sizeof(name) - 1] = '\0';
             }
             if (!strcmp(name, inputName)) {
                 break;
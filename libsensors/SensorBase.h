@@ -26,6 +26,7 @@
 /*****************************************************************************/
 
 struct sensors_event_t;
+struct input_event;
 
 class SensorBase {
 protected:
@@ -35,7 +36,19 @@ protected:
     int         data_fd;
 
     static int openInput(const char* inputName);
-    static int64_t getTimestamp();
+
+    // what an EV_SYN means for the frame being decoded, see checkSyn()
+    enum {
+        FRAME_SKIP,
+        FRAME_READY,
+        FRAME_RESYNC,
+    };
+
+    bool        mDropping;      // between SYN_DROPPED and the next SYN_REPORT
+    uint32_t    mDropped;       // SYN_DROPPED seen since open
+
+    int checkSyn(input_event const* event);
+    int getAbsValue(int code, int* value) const;
 
 
     static int64_t timevalToNano(timeval const& t) {
@@ -44,6 +57,7 @@ protected:
 
     int open_device();
     int close_device();
+    int reopenInput();
 
 public:
             SensorBase(
@@ -52,10 +66,17 @@ public:
 
     virtual ~SensorBase();
 
+    static int64_t getTimestamp();
+
     virtual int readEvents(sensors_event_t* data, int count) = 0;
     virtual bool hasPendingEvents() const;
+    virtual int64_t getDeadline() const;
+    virtual bool canRelease() const;
+    virtual int64_t getWatchdogPeriod() const;
+    virtual int recover();
     virtual int getFd() const;
     virtual int setDelay(int32_t handle, int64_t ns);
+    virtual int setBatchTimeout(int32_t handle, int64_t ns);
     virtual int enable(int32_t handle, int enabled) = 0;
 };
 
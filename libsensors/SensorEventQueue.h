@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_EVENT_QUEUE_H
+#define ANDROID_SENSOR_EVENT_QUEUE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensors.h>
+
+/*****************************************************************************/
+
+/*
+ * Fixed capacity FIFO of finished events, for drivers that can produce
+ * more than one event per input frame. Events are queued as frames are
+ * decoded and handed out by read() as room in the caller's buffer allows.
+ */
+template <int N>
+class SensorEventQueue {
+    sensors_event_t mEvents[N];
+    int mHead;
+    int mCount;
+
+public:
+    SensorEventQueue() : mHead(0), mCount(0) { }
+
+    bool isEmpty() const { return mCount == 0; }
+    int room() const { return N - mCount; }
+    void clear() { mHead = 0; mCount = 0; }
+
+    // the caller checks room() first
+    void push(sensors_event_t const& event) {
+        mEvents[(mHead + mCount) % N] = event;
+        mCount++;
+    }
+
+    int read(sensors_event_t* data, int count) {
+        int n = 0;
+        while (n < count && mCount) {
+            data[n++] = mEvents[mHead];
+            mHead = (mHead + 1) % N;
+            mCount--;
+        }
+        return n;
+    }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_EVENT_QUEUE_H
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <cutils/atomic.h>
+#include <cutils/log.h>
+
+#include "nusensors.h"
+#include "SensorStats.h"
+#include "RotationBoost.h"
+
+// how often the totals are written out, only when the poll thread is up anyway
+#define DUMP_PERIOD_NS  60000000000LL
+
+// upper bounds of the rate buckets, anything slower or never set goes last
+static const int sRateLimitsMs[SensorStats::NUM_RATES - 1] = { 10, 20, 40, 70, 100, 200 };
+
+/*****************************************************************************/
+
+static int rateBucket(int32_t us)
+{
+    int i = 0;
+    while (us >= 0 && i < SensorStats::NUM_RATES - 1 && us > sRateLimitsMs[i] * 1000) {
+        i++;
+    }
+    return us < 0 ? SensorStats::NUM_RATES - 1 : i;
+}
+
+SensorStats::SensorStats()
+    : mActive(0),
+      mDirty(false),
+      mSince(0),
+      mStart(0),
+      mNextDump(0)
+{
+    memset(mStats, 0, sizeof(mStats));
+    memset(mLatency, 0, sizeof(mLatency));
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        mStats[h].rate = NUM_RATES - 1;
+    }
+
+    // one file per process, the framework and sensorhubd each open the HAL
+    char comm[16] = "unknown";
+    int fd = open("/proc/self/comm", O_RDONLY);
+    if (fd >= 0) {
+        int n = read(fd, comm, sizeof(comm) - 1);
+        comm[n > 0 ? n : 0] = 0;
+        char* newline = strchr(comm, '\n');
+        if (newline) {
+            *newline = 0;
+        }
+        close(fd);
+    }
+    snprintf(mPath, sizeof(mPath), SENSOR_STATS_FILE, comm);
+}
+
+void SensorStats::setSensors(struct sensor_t const* list, int count)
+{
+    for (int i=0 ; i<count ; i++) {
+        if (list[i].handle >= 0 && list[i].handle < MAX_HANDLES) {
+            mStats[list[i].handle].name = list[i].name;
+            mStats[list[i].handle].power = list[i].power;
+        }
+    }
+}
+
+void SensorStats::accumulate(int64_t now)
+{
+    if (!mStart) {
+        mStart = now;
+        mNextDump = now + DUMP_PERIOD_NS;
+    }
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        stats_t& s(mStats[h]);
+        if (mActive & (1 << h)) {
+            s.activeNs += now - mSince;
+            s.rateNs[s.rate] += now - mSince;
+        }
+    }
+    mSince = now;
+}
+
+void SensorStats::update(int64_t now, int32_t active, volatile int32_t const* delayUs)
+{
+    accumulate(now);
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        mStats[h].rate = rateBucket(android_atomic_acquire_load(&delayUs[h]));
+    }
+    mActive = active;
+    mDirty |= active != 0;
+}
+
+/*
+ * A wakeup is a batch holding events of a wake-up sensor, which is what
+ * makes the HAL keep the system up, so each handle counts once per batch.
+ */
+void SensorStats::countEvents(sensors_event_t const* data, int count, int64_t now)
+{
+    int32_t woken = 0;
+    for (int i=0 ; i<count ; i++) {
+        // from the sample to its delivery, which is what the poll policy buys
+        mLatency[latencyBucket(now - data[i].timestamp)]++;
+        int h = data[i].sensor;
+        if (h < 0 || h >= MAX_HANDLES)
+            continue;
+        mStats[h].events++;
+        if (h >= ID_WAKE_UP || (ONE_SHOT_HANDLES & (1 << h))) {
+            woken |= 1 << h;
+        }
+    }
+    for (int h=0 ; woken ; h++, woken >>= 1) {
+        if (woken & 1) {
+            mStats[h].wakeups++;
+        }
+    }
+}
+
+void SensorStats::dump(int64_t now, int64_t const* shareNs)
+{
+    accumulate(now);
+    mNextDump = now + DUMP_PERIOD_NS;
+    mDirty = mActive != 0;
+
+    char tmp[sizeof(mPath) + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", mPath);
+    FILE* file = fopen(tmp, "w");
+    if (!file) {
+        ALOGE("couldn't write %s (%s)", tmp, strerror(errno));
+        return;
+    }
+
+    fprintf(file, "# since %llds, times in ms, charge in uAh, shared ones split\n",
+            (long long)((now - mStart) / 1000000000LL));
+    fprintf(file, "# handle active events wakeups charge");
+    for (int i=0 ; i<NUM_RATES - 1 ; i++) {
+        fprintf(file, " <=%dms", sRateLimitsMs[i]);
+    }
+    fprintf(file, " slower name\n");
+
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        stats_t const& s(mStats[h]);
+        if (!s.name)
+            continue;
+        const int64_t chargedNs = shareNs ? shareNs[h] : s.activeNs;
+        // mA * ns / 3.6e9 = uAh
+        fprintf(file, "%d %lld %u %u %.1f", h, (long long)(s.activeNs / 1000000),
+                s.events, s.wakeups, s.power * chargedNs / 3.6e9);
+        for (int i=0 ; i<NUM_RATES ; i++) {
+            fprintf(file, " %lld", (long long)(s.rateNs[i] / 1000000));
+        }
+        fprintf(file, " %s\n", s.name);
+    }
+    int p50 = percentile(mLatency, 50);
+    if (p50 >= 0) {
+        int p99 = percentile(mLatency, 99);
+        fprintf(file, "# latency p50 <=%uus, p99 <=%uus, histogram by log2(us):",
+                latencyBound(p50), latencyBound(p99));
+        for (int i=0 ; i<LATENCY_BUCKETS ; i++) {
+            fprintf(file, " %u", mLatency[i]);
+        }
+        fprintf(file, "\n");
+    }
+    RotationBoost::dumpStats(file);
+
+    if (fclose(file) || rename(tmp, mPath)) {
+        ALOGE("couldn't write %s (%s)", mPath, strerror(errno));
+        unlink(tmp);
+    }
+}
+
+int SensorStats::latencyBucket(int64_t ns)
+{
+    int64_t us = ns / 1000;
+    if (us <= 1)
+        return 0;
+    if (us >= 0x7fffffffLL)
+        return LATENCY_BUCKETS - 1;
+    return 31 - __builtin_clz(uint32_t(us));
+}
+
+uint32_t SensorStats::latencyBound(int bucket)
+{
+    return bucket < 31 ? 2u << bucket : 0xffffffffu;
+}
+
+int SensorStats::percentile(uint32_t const* histogram, int percent)
+{
+    uint64_t total = 0;
+    for (int i=0 ; i<LATENCY_BUCKETS ; i++) {
+        total += histogram[i];
+    }
+    uint64_t seen = 0;
+    for (int i=0 ; i<LATENCY_BUCKETS && total ; i++) {
+        seen += histogram[i];
+        if (seen * 100 >= total * percent)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * A request is SENSOR_STATS_REQUEST being touched or written, which every
+ * process with the HAL open answers. Only that file is watched, so
+ * nothing else, our own dumps included, wakes the poll thread up.
+ */
+int SensorStats::openRequests()
+{
+    int file = open(SENSOR_STATS_REQUEST, O_WRONLY | O_CREAT, 0660);
+    if (file >= 0) {
+        close(file);
+    }
+    int fd = inotify_init();
+    if (fd < 0 || inotify_add_watch(fd, SENSOR_STATS_REQUEST, IN_ATTRIB | IN_CLOSE_WRITE) < 0) {
+        ALOGE("couldn't watch %s, no stats on request (%s)", SENSOR_STATS_REQUEST, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+bool SensorStats::takeRequests(int fd)
+{
+    bool requested = false;
+    char buffer[512] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (int i=0 ; i + int(sizeof(struct inotify_event)) <= n ; ) {
+            struct inotify_event const* event =
+                    reinterpret_cast<struct inotify_event const*>(buffer + i);
+            if (event->mask & (IN_ATTRIB | IN_CLOSE_WRITE)) {
+                requested = true;
+            }
+            i += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return requested;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_STATS_H
+#define ANDROID_SENSOR_STATS_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include <hardware/sensors.h>
+
+/*****************************************************************************/
+
+/*
+ * Per handle accounting of what the sensors cost: time enabled, split by
+ * requested rate, events delivered, wakeups caused and the charge that
+ * works out to from sensor_t.power, and a log2 histogram of how long
+ * after their sample events are delivered. A handle active in several
+ * processes is charged to each for its share of the time only. Poll thread only;
+ * the totals are written as text to a file per process, see
+ * sensorstats.sh, which asks for fresh ones by touching the request file.
+ * The directory is the HAL's alone, init creates it.
+ */
+#define SENSOR_STATS_DIR SENSORS_ROOT "/data/system/sensors"
+#define SENSOR_STATS_FILE SENSOR_STATS_DIR "/%s.stats"
+#define SENSOR_STATS_REQUEST SENSOR_STATS_DIR "/request"
+
+class SensorStats {
+public:
+    enum {
+        MAX_HANDLES = 32,
+        NUM_RATES = 7,          // see sRateLimitsMs
+        LATENCY_BUCKETS = 32,   // log2(us)
+    };
+
+            SensorStats();
+
+    void setSensors(struct sensor_t const* list, int count);
+
+    // Closes the intervals of the handles enabled so far and starts new ones.
+    void update(int64_t now, int32_t active, volatile int32_t const* delayUs);
+    int32_t getActive() const { return mActive; }
+    // Whether a handle was active since the file was last written.
+    bool isDirty() const { return mDirty; }
+    // Counts the events and how late they are, delivered now.
+    void countEvents(sensors_event_t const* data, int count, int64_t now);
+    bool isDumpDue(int64_t now) const { return now >= mNextDump; }
+    // shareNs is the time to charge for each handle, NULL for all of it
+    void dump(int64_t now, int64_t const* shareNs);
+
+    // Bucket of a latency, one stamped in the future counts as none.
+    static int latencyBucket(int64_t ns);
+    // Upper bound of a bucket, in us.
+    static uint32_t latencyBound(int bucket);
+    // Bucket holding the given percentile of a histogram, -1 if it's empty.
+    static int percentile(uint32_t const* histogram, int percent);
+
+    // An fd that polls readable when a dump may have been asked for, or -1.
+    static int openRequests();
+    // Reads the fd out, returns whether a dump was asked for.
+    static bool takeRequests(int fd);
+
+private:
+    struct stats_t {
+        const char* name;
+        float power;            // mA
+        int rate;               // bucket of the current delay
+        int64_t activeNs;
+        int64_t rateNs[NUM_RATES];
+        uint32_t events;
+        uint32_t wakeups;
+    };
+
+    void accumulate(int64_t now);
+
+    stats_t mStats[MAX_HANDLES];
+    uint32_t mLatency[LATENCY_BUCKETS];
+    int32_t mActive;
+    bool mDirty;
+    int64_t mSince;
+    int64_t mStart;
+    int64_t mNextDump;
+    char mPath[64];
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_STATS_H
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host file sink for the trace points in SensorTrace.h. On the device the
+ * macros map straight to atrace and this file is empty.
+ */
+
+#if defined(SENSORS_TRACE) && !defined(HAVE_ANDROID_OS)
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "SensorTrace.h"
+
+/*****************************************************************************/
+
+static pthread_once_t sTraceOnce = PTHREAD_ONCE_INIT;
+static int sTraceFd = -1;
+
+static void openTraceFile()
+{
+    const char* path = getenv("SENSORS_TRACE_FILE");
+    if (path) {
+        sTraceFd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+}
+
+int sensor_trace_enabled(void)
+{
+    pthread_once(&sTraceOnce, openTraceFile);
+    return sTraceFd >= 0;
+}
+
+void sensor_trace_write(char type, const char* name, int32_t value)
+{
+    if (!sensor_trace_enabled())
+        return;
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    const int pid = getpid();
+    const int tid = syscall(SYS_gettid);
+
+    // the same line ftrace produces for a trace_marker write
+    char buffer[256];
+    int len = snprintf(buffer, sizeof(buffer),
+            "sensors-%d [000] ...1 %ld.%06ld: tracing_mark_write: ",
+            tid, long(t.tv_sec), long(t.tv_nsec / 1000));
+    switch (type) {
+        case 'B':
+            len += snprintf(buffer + len, sizeof(buffer) - len, "B|%d|%s\n", pid, name);
+            break;
+        case 'C':
+            len += snprintf(buffer + len, sizeof(buffer) - len, "C|%d|%s|%d\n", pid, name, value);
+            break;
+        default:
+            len += snprintf(buffer + len, sizeof(buffer) - len, "E\n");
+            break;
+    }
+    if (len > int(sizeof(buffer)) - 1) {
+        len = sizeof(buffer) - 1;
+    }
+    write(sTraceFd, buffer, len);
+}
+
+#endif // SENSORS_TRACE && !HAVE_ANDROID_OS
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_TRACE_H
+#define ANDROID_SENSOR_TRACE_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+/*****************************************************************************/
+
+/*
+ * Trace points that line the HAL up with the kernel and the framework in
+ * systrace. They are only built with -DSENSORS_TRACE (see Android.mk),
+ * otherwise every macro compiles away. On the device they go to atrace
+ * under the "hal" tag, which costs a single load while nobody captures.
+ * Host builds write the same records, in systrace text format, to the
+ * file named by $SENSORS_TRACE_FILE.
+ */
+
+#ifdef SENSORS_TRACE
+
+#ifdef HAVE_ANDROID_OS
+
+#define ATRACE_TAG ATRACE_TAG_HAL
+#include <cutils/trace.h>
+
+#define SENSOR_TRACE_ENABLED()          ATRACE_ENABLED()
+#define SENSOR_TRACE_BEGIN(name)        ATRACE_BEGIN(name)
+#define SENSOR_TRACE_END()              ATRACE_END()
+#define SENSOR_TRACE_INT(name, value)   ATRACE_INT(name, value)
+
+#else
+
+__BEGIN_DECLS
+int sensor_trace_enabled(void);
+void sensor_trace_write(char type, const char* name, int32_t value);
+__END_DECLS
+
+#define SENSOR_TRACE_ENABLED()          sensor_trace_enabled()
+#define SENSOR_TRACE_BEGIN(name)        sensor_trace_write('B', name, 0)
+#define SENSOR_TRACE_END()              sensor_trace_write('E', NULL, 0)
+#define SENSOR_TRACE_INT(name, value)   sensor_trace_write('C', name, value)
+
+#endif // HAVE_ANDROID_OS
+
+#else
+
+#define SENSOR_TRACE_ENABLED()          0
+#define SENSOR_TRACE_BEGIN(name)        ((void)0)
+#define SENSOR_TRACE_END()              ((void)0)
+#define SENSOR_TRACE_INT(name, value)   ((void)0)
+
+#endif // SENSORS_TRACE
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSOR_TRACE_H
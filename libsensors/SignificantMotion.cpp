@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SignificantMotion.h"
+
+/*****************************************************************************/
+
+SignificantMotion::SignificantMotion()
+{
+    reset();
+}
+
+void SignificantMotion::reset()
+{
+    memset(mBaseline, 0, sizeof(mBaseline));
+    mHistory = 0;
+    mSeeded = false;
+}
+
+bool SignificantMotion::addSample(const int* raw)
+{
+    if (!mSeeded) {
+        for (int i=0 ; i<3 ; i++) {
+            mBaseline[i] = raw[i] << 4;
+        }
+        mSeeded = true;
+        return false;
+    }
+
+    int distance = 0;
+    for (int i=0 ; i<3 ; i++) {
+        int v = raw[i] << 4;
+        distance += abs(v - mBaseline[i]);
+        mBaseline[i] += (v - mBaseline[i]) >> 3;
+    }
+
+    mHistory = (mHistory << 1) | (distance > (MOTION_LSB << 4) ? 1 : 0);
+    return __builtin_popcount(mHistory) >= MOTION_SAMPLES;
+}
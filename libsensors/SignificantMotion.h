@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SIGNIFICANT_MOTION_H
+#define ANDROID_SIGNIFICANT_MOTION_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Detects motion that lasts, as opposed to a single bump or tilt, on a low
+ * rate raw accelerometer stream. Every sample is compared against a slowly
+ * tracking baseline and the result is kept as one bit of history; the
+ * detector triggers once most of the recent history is moving.
+ */
+class SignificantMotion {
+public:
+    enum {
+        DELAY_MS = 100,         // hardware delay while only we are enabled
+        MOTION_LSB = 24,        // ~0.1g away from the baseline, all axes
+        MOTION_SAMPLES = 20,    // out of the last 32 (3.2s at DELAY_MS)
+    };
+
+            SignificantMotion();
+
+    void reset();
+
+    // Feeds one raw sample, returns true when significant motion is seen.
+    bool addSample(const int* raw);
+
+private:
+    int mBaseline[3];           // raw value << 4
+    uint32_t mHistory;
+    bool mSeeded;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SIGNIFICANT_MOTION_H
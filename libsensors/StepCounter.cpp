@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "StepCounter.h"
+
+/*****************************************************************************/
+
+StepCounter::StepCounter()
+    : mSteps(0)
+{
+    reset();
+}
+
+void StepCounter::reset()
+{
+    memset(mRing, 0, sizeof(mRing));
+    mSum = 0;
+    mPos = 0;
+    mFill = 0;
+    mBaseline = 0;
+    mAbove = false;
+    mLastStep = 0;
+}
+
+bool StepCounter::addSample(const int* raw, int64_t timestamp)
+{
+    // 1g reads as 256 LSB, so this is ~256 at rest
+    int magnitude = (raw[0]*raw[0] + raw[1]*raw[1] + raw[2]*raw[2]) >> 8;
+
+    mSum += magnitude - mRing[mPos];
+    mRing[mPos] = magnitude;
+    mPos = (mPos + 1) & (SMOOTHING - 1);
+    if (mFill < SMOOTHING) {
+        if (++mFill == SMOOTHING) {
+            mBaseline = (mSum / SMOOTHING) << 4;
+        }
+        return false;
+    }
+
+    int smooth = mSum / SMOOTHING;
+    int signal = smooth - (mBaseline >> 4);
+    mBaseline += ((smooth << 4) - mBaseline) >> 5;
+
+    if (!mAbove) {
+        mAbove = signal > STEP_HIGH;
+        return false;
+    }
+    if (signal > STEP_LOW) {
+        return false;
+    }
+
+    mAbove = false;
+    if (timestamp - mLastStep < MIN_STEP_MS * 1000000LL) {
+        return false;
+    }
+    mLastStep = timestamp;
+    mSteps++;
+    return true;
+}
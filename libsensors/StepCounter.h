@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_STEP_COUNTER_H
+#define ANDROID_STEP_COUNTER_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * Streaming step detection on raw accelerometer samples. The squared
+ * magnitude is smoothed by a short moving average, gravity is removed by a
+ * slow baseline and a step is a peak that rises above STEP_HIGH and falls
+ * back below STEP_LOW, at least MIN_STEP_MS after the previous one.
+ * Integer math only, and the state is a fixed handful of words.
+ */
+class StepCounter {
+public:
+    enum {
+        DELAY_MS = 40,          // 25Hz is plenty for walking cadence
+        SMOOTHING = 4,          // samples, power of two
+        STEP_HIGH = 48,         // ~0.1g above the baseline
+        STEP_LOW = 16,
+        MIN_STEP_MS = 250,
+    };
+
+            StepCounter();
+
+    // Clears the filters, the step count is kept.
+    void reset();
+
+    // Feeds one raw sample, returns true if it completes a step.
+    bool addSample(const int* raw, int64_t timestamp);
+    uint64_t getSteps() const { return mSteps; }
+
+private:
+    int mRing[SMOOTHING];
+    int mSum;
+    int mPos;
+    int mFill;
+    int mBaseline;              // smoothed magnitude << 4
+    bool mAbove;
+    int64_t mLastStep;
+    uint64_t mSteps;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_STEP_COUNTER_H
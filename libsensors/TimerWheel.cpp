@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include <cutils/log.h>
+
+#include "SensorBase.h"
+#include "SensorTrace.h"
+#include "TimerWheel.h"
+
+/*****************************************************************************/
+
+SensorTimer::SensorTimer()
+    : mNext(NULL),
+      mPrev(NULL),
+      mWhen(0),
+      mTick(0),
+      mCallback(NULL),
+      mCookie(NULL)
+{
+}
+
+void SensorTimer::init(callback_t callback, void* cookie)
+{
+    mCallback = callback;
+    mCookie = cookie;
+}
+
+/*****************************************************************************/
+
+TimerWheel::TimerWheel()
+    : mSlackNs(DEFAULT_SLACK_US * 1000LL),
+      mArmed(0),
+      mExpiring(false)
+{
+    for (int i=0 ; i<NUM_SLOTS ; i++) {
+        mSlots[i].mNext = mSlots[i].mPrev = &mSlots[i];
+    }
+    mCurrent = SensorBase::getTimestamp() / mSlackNs;
+
+    mFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    ALOGE_IF(mFd<0, "error creating timerfd (%s)", strerror(errno));
+}
+
+TimerWheel::~TimerWheel()
+{
+    if (mFd >= 0) {
+        close(mFd);
+    }
+}
+
+/*
+ * Only while nothing is scheduled, the ticks of pending timers would no
+ * longer match their slots.
+ */
+void TimerWheel::setSlack(int64_t ns)
+{
+    if (ns <= 0)
+        return;
+    for (int i=0 ; i<NUM_SLOTS ; i++) {
+        if (mSlots[i].mNext != &mSlots[i]) {
+            ALOGE("timer slack can't change with timers pending");
+            return;
+        }
+    }
+    mSlackNs = ns;
+    mCurrent = SensorBase::getTimestamp() / mSlackNs;
+}
+
+void TimerWheel::schedule(SensorTimer* timer, int64_t when)
+{
+    if (!when) {
+        cancel(timer);
+        return;
+    }
+    if (timer->isPending() && timer->mWhen == when)
+        return;
+
+    // the timerfd may be armed for where this one was
+    const bool wasArmed = timer->isPending() && timer->mTick * mSlackNs == mArmed;
+    unlink(timer);
+    link(timer, when);
+
+    if (mExpiring)
+        return;
+    if (wasArmed) {
+        arm(earliest());
+    } else if (!mArmed || timer->mTick * mSlackNs < mArmed) {
+        arm(timer->mTick * mSlackNs);
+    }
+}
+
+// without it, a moved watchdog would still wake the poll thread for nothing
+void TimerWheel::cancel(SensorTimer* timer)
+{
+    if (!timer->isPending())
+        return;
+    const bool wasArmed = timer->mTick * mSlackNs == mArmed;
+    unlink(timer);
+    if (wasArmed && !mExpiring) {
+        arm(earliest());
+    }
+}
+
+void TimerWheel::link(SensorTimer* timer, int64_t when)
+{
+    // rounded up, a timer never fires early; one already due goes on the next tick
+    int64_t tick = (when + mSlackNs - 1) / mSlackNs;
+    if (tick <= mCurrent) {
+        tick = mCurrent + 1;
+    }
+    timer->mWhen = when;
+    timer->mTick = tick;
+
+    SensorTimer* head = &mSlots[tick & (NUM_SLOTS - 1)];
+    timer->mNext = head->mNext;
+    timer->mPrev = head;
+    head->mNext->mPrev = timer;
+    head->mNext = timer;
+}
+
+void TimerWheel::unlink(SensorTimer* timer)
+{
+    if (!timer->isPending())
+        return;
+    timer->mPrev->mNext = timer->mNext;
+    timer->mNext->mPrev = timer->mPrev;
+    timer->mNext = timer->mPrev = NULL;
+}
+
+int TimerWheel::expire()
+{
+    uint64_t expirations;
+    if (read(mFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        ALOGE("error reading timerfd (%s)", strerror(errno));
+    }
+    mArmed = 0;
+    mExpiring = true;
+
+    const int64_t now = SensorBase::getTimestamp();
+    const int64_t tick = now / mSlackNs;
+    int fired = 0;
+
+    // moved first, so a callback scheduling for now lands on the next tick
+    const int64_t from = mCurrent;
+    if (tick > mCurrent) {
+        mCurrent = tick;
+    }
+
+    // a slot holds timers of later turns too, only the due ones go
+    int64_t last = tick - from > NUM_SLOTS ? from + NUM_SLOTS : tick;
+    for (int64_t t=from+1 ; t<=last ; t++) {
+        SensorTimer* const head = &mSlots[t & (NUM_SLOTS - 1)];
+        SensorTimer* timer = head->mNext;
+        while (timer != head) {
+            if (timer->mTick > tick) {
+                timer = timer->mNext;
+                continue;
+            }
+            unlink(timer);
+            if (timer->mCallback) {
+                timer->mCallback(timer->mCookie, now);
+            }
+            fired++;
+            // the callback may have changed anything in the list
+            timer = head->mNext;
+        }
+    }
+
+    SENSOR_TRACE_INT("timers fired", fired);
+    mExpiring = false;
+    arm(earliest());
+    return fired;
+}
+
+int64_t TimerWheel::earliest() const
+{
+    int64_t tick = 0;
+    for (int i=0 ; i<NUM_SLOTS ; i++) {
+        for (SensorTimer* timer = mSlots[i].mNext ; timer != &mSlots[i] ; timer = timer->mNext) {
+            if (!tick || timer->mTick < tick) {
+                tick = timer->mTick;
+            }
+        }
+    }
+    return tick * mSlackNs;
+}
+
+void TimerWheel::arm(int64_t when)
+{
+    if (when == mArmed)
+        return;
+
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = when / 1000000000LL;
+    spec.it_value.tv_nsec = when % 1000000000LL;
+    // an absolute time of 0 disarms it
+    if (timerfd_settime(mFd, TFD_TIMER_ABSTIME, &spec, NULL)) {
+        ALOGE("error arming timerfd (%s)", strerror(errno));
+        return;
+    }
+    mArmed = when;
+}
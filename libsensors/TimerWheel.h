@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2008 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_TIMER_WHEEL_H
+#define ANDROID_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/*
+ * A deadline on the poll thread. Timers are embedded in their owner and
+ * linked into the wheel while pending, so scheduling never allocates. One
+ * without a callback only wakes the poll thread up.
+ */
+class SensorTimer {
+public:
+    typedef void (*callback_t)(void* cookie, int64_t now);
+
+            SensorTimer();
+
+    void init(callback_t callback, void* cookie);
+    bool isPending() const { return mPrev != NULL; }
+    int64_t getWhen() const { return mWhen; }
+
+private:
+    friend class TimerWheel;
+
+    SensorTimer* mNext;
+    SensorTimer* mPrev;         // NULL while not scheduled
+    int64_t mWhen;              // monotonic ns
+    int64_t mTick;
+    callback_t mCallback;
+    void* mCookie;
+};
+
+/*
+ * Every deadline of the HAL behind a single timerfd, which sits in the
+ * poll set like any input device. Deadlines are rounded up to a tick of
+ * the configured slack and hashed by tick into NUM_SLOTS lists, so all
+ * timers falling in the same tick expire on the same wakeup. Linking and
+ * unlinking a timer is O(1); finding the next timer to arm the timerfd
+ * for is O(slots + timers), and is only done after an expiry or when the
+ * timer the timerfd is armed for moves or goes. The HAL has four timers.
+ * Only the poll thread may use it.
+ */
+class TimerWheel {
+public:
+    enum {
+        NUM_SLOTS = 64,         // power of two
+        DEFAULT_SLACK_US = 1000,
+    };
+
+            TimerWheel();
+            ~TimerWheel();
+
+    int getFd() const { return mFd; }
+    void setSlack(int64_t ns);
+
+    // (Re)schedules a timer for a monotonic time, 0 cancels it.
+    void schedule(SensorTimer* timer, int64_t when);
+    void cancel(SensorTimer* timer);
+
+    // The timerfd became readable: runs the callbacks of the timers due.
+    int expire();
+
+private:
+    SensorTimer mSlots[NUM_SLOTS];      // list heads
+    int mFd;
+    int64_t mSlackNs;
+    int64_t mCurrent;           // last tick expire() went through
+    int64_t mArmed;             // what the timerfd is set to, 0 for nothing
+    bool mExpiring;             // expire() arms the timerfd once done
+
+    void link(SensorTimer* timer, int64_t when);
+    void unlink(SensorTimer* timer);
+    void arm(int64_t when);
+    int64_t earliest() const;
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_TIMER_WHEEL_H
@@ -18,48 +18,178 @@
 #include <errno.h>
 #include <dirent.h>
 #include <math.h>
+#include <malloc.h>
+#include <new>
 
 #include <poll.h>
 #include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
 
 #include <linux/input.h>
 
 #include <cutils/atomic.h>
 #include <cutils/log.h>
 
+#include <hardware_legacy/power.h>
+
 #include "nusensors.h"
 #include "BMA250.h"
 #include "STK-ALS22x7.h"
+#include "PollPolicy.h"
+#include "SensorArbiter.h"
+#include "SensorArena.h"
+#include "SensorStats.h"
+#include "SensorTrace.h"
+#include "TimerWheel.h"
+
+#ifndef EPOLLWAKEUP
+#define EPOLLWAKEUP (1u << 29)
+#endif
+
+// Android 3.0 evdev: hold a suspend blocker while the client queue is not empty
+#ifndef EVIOCSSUSPENDBLOCK
+#define EVIOCSSUSPENDBLOCK _IOW('E', 0x91, int)
+#endif
+
+#define WAKE_LOCK_ID "SensorsHAL"
+
+// early suspend, the last the 3.0 kernel tells userspace before suspending
+#define WAIT_FOR_FB_SLEEP_FILE SENSORS_ROOT "/sys/power/wait_for_fb_sleep"
+#define WAIT_FOR_FB_WAKE_FILE SENSORS_ROOT "/sys/power/wait_for_fb_wake"
 /*****************************************************************************/
 
 struct sensors_poll_context_t {
-    struct sensors_poll_device_t device; // must be first
+    sensors_poll_device_1_t device; // must be first
 
-        sensors_poll_context_t();
+        sensors_poll_context_t(SensorArena& arena, bool primary);
         ~sensors_poll_context_t();
+    static size_t arenaSize();
     int activate(int handle, int enabled);
     int setDelay(int handle, int64_t ns);
+    int batch(int handle, int flags, int64_t period_ns, int64_t timeout);
     int pollEvents(sensors_event_t* data, int count);
+    void setSensorList(struct sensor_t const* list, int count);
 
 private:
     enum {
         bma250   = 0,
         als22x7  = 1,
         numSensorDrivers,
+        timer    = numSensorDrivers,
+        wake,
+        stats,                  // requests for the stats, see SensorStats
         numFds,
     };
 
-    static const size_t wake = numFds - 1;
+    enum {
+        maxHandles = 32,        // one bit each in the request masks
+    };
+
+    // an unused driver is closed this long after its last handle went off
+    static const int64_t RELEASE_DELAY_NS = 10000000000LL;
+
+    // input missing for this many periods, and at least the minimum, is a stall
+    static const int WATCHDOG_PERIODS = 10;
+    static const int64_t WATCHDOG_MIN_NS = 1000000000LL;
+
     static const char WAKE_MESSAGE = 'W';
-    struct pollfd mPollFds[numFds];
+    static const char SUSPEND_MESSAGE = 'S';
+    static const char RESUME_MESSAGE = 'R';
+    struct pollfd mPollFds[numFds];     // revents filled in from epoll_wait()
+    int mEpollFd;
     int mWritePipeFd;
-    SensorBase* mSensors[numSensorDrivers];
+    SensorBase* mSensors[numSensorDrivers];     // NULL until first enabled
+    void* mSlots[numSensorDrivers];             // arena memory for each driver
+
+    // poll thread only
+    int32_t mActive;                    // handles enabled in the drivers
+    int32_t mDriverHandles[numSensorDrivers];
+    int64_t mReleaseAt[numSensorDrivers];       // 0 while in use or closed
+    int64_t mLastInput[numSensorDrivers];       // monotonic, when input last came
+    TimerWheel mTimers;
+    SensorTimer mDriverTimers[numSensorDrivers];    // the drivers' getDeadline()
+    SensorTimer mReleaseTimer;
+    SensorTimer mWatchdogTimer;
+    uint32_t mRecoveries;
+    SensorStats mStats;
+    bool mWakeUpArmed[numSensorDrivers];
+    bool mWakeUpPending;                // wake-up events are being returned
+    bool mWakeLockHeld;
+    bool mSuspended;                    // SUSPEND_PAUSED_HANDLES are off
+    PollPolicy mPolicy;
+    SensorArbiter mArbiter;
+
+    /*
+     * activate() and setDelay() come in on binder threads while the poll
+     * thread sits in pollEvents(). They only publish the requested state
+     * here and wake the poll thread, which alone touches the drivers,
+     * so the drivers need no locking and the event path takes no lock.
+     */
+    volatile int32_t mEnableRequest;        // requested state, one bit per handle
+    volatile int32_t mEnableDirty;          // handles whose enable changed
+    volatile int32_t mDelayDirty;           // handles whose delay changed
+    volatile int32_t mDelayUs[maxHandles];  // requested delay, -1 if never set
+    volatile int32_t mBatchUs[maxHandles];  // requested batch timeout, 0 for none
+
+    /*
+     * activate() never waits for the poll thread: it checks what it can
+     * itself, and an enable that the driver then refuses is reported by
+     * the next activate() of the handle.
+     */
+    volatile int32_t mEnableError[maxHandles];  // -errno, 0 once reported
+
+    void wakePollThread();
+    static const char* enableFile(int index);
+    void applyRequests();
+    int32_t fastestDelay(int base, int32_t enabled) const;
+    int32_t shortestBatch(int base, int32_t enabled) const;
+    void armWakeUp();
+    void retireOneShots(int32_t fired);
+    void updateStats(int64_t now);
+    void dumpStats(int64_t now);
+    sensors_poll_context_t* mNextSuspendListener;   // under sSuspendLock
+    void listenForSuspend();
+    void stopListeningForSuspend();
+    static void startSuspendThread();
+    static void* suspendThread(void* cookie);
+    static void postSuspend(bool suspended);
+    SensorBase* openDriver(int index);
+    void releaseDriver(int index);
+    void scheduleReleases();
+    void releaseIdleDrivers();
+    int64_t stallTimeout(int index) const;
+    void scheduleWatchdog();
+    void checkWatchdog();
+    void watchFd(int index, int op, bool wakeUp);
+    int routeFlavours(sensors_event_t* data, int count);
+    void scheduleDeadlines();
+    static void onReleaseTimer(void* cookie, int64_t now);
+    static void onWatchdogTimer(void* cookie, int64_t now);
+    int waitForEvents(int timeout);
+
+#ifdef SENSORS_TRACE
+    int32_t mTraceEvents[maxHandles];       // per handle, since mTraceStart
+    uint32_t mTraceLatency[SensorStats::LATENCY_BUCKETS];   // since mTraceStart
+    int64_t mTraceStart;
+    void traceRates(sensors_event_t const* data, int count);
+#endif
 
     int handleToDriver(int handle) const {
         switch (handle) {
             case ID_A:
+            case ID_WAKE_UP+ID_A:
+            case ID_SM:
+            case ID_SD:
+            case ID_WAKE_UP+ID_SD:
+            case ID_SC:
+            case ID_WAKE_UP+ID_SC:
+            case ID_FD:
+            case ID_SK:
+            case ID_DT:
             	return bma250;
             case ID_B:
+            case ID_WAKE_UP+ID_B:
             	return als22x7;
         }
         return -EINVAL;
@@ -68,17 +198,58 @@ private:
 
 /*****************************************************************************/
 
-sensors_poll_context_t::sensors_poll_context_t()
+size_t sensors_poll_context_t::arenaSize()
+{
+    return SensorArena::align(sizeof(sensors_poll_context_t)) +
+            BMA250Sensor::arenaSize() +
+            STK_ALS22x7Sensor::arenaSize();
+}
+
+sensors_poll_context_t::sensors_poll_context_t(SensorArena& arena, bool primary)
+    : mActive(0),
+      mWakeUpPending(false),
+      mWakeLockHeld(false),
+      mSuspended(false),
+      mEnableRequest(0),
+      mEnableDirty(0),
+      mDelayDirty(0)
 {
-    mSensors[bma250] = new BMA250Sensor();
-    mPollFds[bma250].fd = mSensors[bma250]->getFd();
-    mPollFds[bma250].events = POLLIN;
-    mPollFds[bma250].revents = 0;
+    for (int i=0 ; i<maxHandles ; i++) {
+        mDelayUs[i] = -1;
+        mBatchUs[i] = 0;
+        mEnableError[i] = 0;
+    }
+#ifdef SENSORS_TRACE
+    memset(mTraceEvents, 0, sizeof(mTraceEvents));
+    memset(mTraceLatency, 0, sizeof(mTraceLatency));
+    mTraceStart = 0;
+#endif
+    mPolicy.load();
+    mArbiter.setPrimary(primary);
 
-    mSensors[als22x7] = new STK_ALS22x7Sensor();
-    mPollFds[als22x7].fd = mSensors[als22x7]->getFd();
-    mPollFds[als22x7].events = POLLIN;
-    mPollFds[als22x7].revents = 0;
+    // the drivers are only built on first use, see openDriver()
+    mSlots[bma250] = arena.alloc(sizeof(BMA250Sensor));
+    mSlots[als22x7] = arena.alloc(sizeof(STK_ALS22x7Sensor));
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        mSensors[i] = NULL;
+        mPollFds[i].fd = -1;
+        mPollFds[i].events = POLLIN;
+        mPollFds[i].revents = 0;
+        mDriverHandles[i] = 0;
+        mReleaseAt[i] = 0;
+        mLastInput[i] = 0;
+    }
+    for (int handle=0 ; handle<maxHandles ; handle++) {
+        int index = handleToDriver(handle);
+        if (index >= 0) {
+            mDriverHandles[index] |= 1 << handle;
+        }
+    }
+    mRecoveries = 0;
+
+    mTimers.setSlack(mPolicy.getCoalesceNs());
+    mReleaseTimer.init(onReleaseTimer, this);
+    mWatchdogTimer.init(onWatchdogTimer, this);
 
     int wakeFds[2];
     int result = pipe(wakeFds);
@@ -90,51 +261,714 @@ sensors_poll_context_t::sensors_poll_context_t()
     mPollFds[wake].fd = wakeFds[0];
     mPollFds[wake].events = POLLIN;
     mPollFds[wake].revents = 0;
+    listenForSuspend();
+
+    mPollFds[timer].fd = mTimers.getFd();
+    mPollFds[timer].events = POLLIN;
+    mPollFds[timer].revents = 0;
+
+    mPollFds[stats].fd = SensorStats::openRequests();
+    mPollFds[stats].events = POLLIN;
+    mPollFds[stats].revents = 0;
+
+    mEpollFd = epoll_create(numFds);
+    ALOGE_IF(mEpollFd<0, "error creating epoll fd (%s)", strerror(errno));
+    for (int i=0 ; i<numFds ; i++) {
+        watchFd(i, EPOLL_CTL_ADD, false);
+    }
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        mWakeUpArmed[i] = false;
+    }
 }
 
 sensors_poll_context_t::~sensors_poll_context_t() {
+    // the memory belongs to the arena
     for (int i=0 ; i<numSensorDrivers ; i++) {
-        delete mSensors[i];
+        if (mSensors[i]) {
+            mSensors[i]->~SensorBase();
+        }
+    }
+    stopListeningForSuspend();
+    // nothing will write the last intervals later
+    const int64_t now = SensorBase::getTimestamp();
+    mActive = 0;
+    updateStats(now);
+    if (mStats.isDirty()) {
+        dumpStats(now);
+    }
+    if (mPollFds[stats].fd >= 0) {
+        close(mPollFds[stats].fd);
     }
     close(mPollFds[wake].fd);
     close(mWritePipeFd);
+    close(mEpollFd);
+    if (mWakeLockHeld) {
+        release_wake_lock(WAKE_LOCK_ID);
+    }
+}
+
+/*
+ * Building a driver scans /dev/input and reads sysfs, which has no place
+ * on the open_sensors() path: it is done on the poll thread when one of
+ * the driver's handles is first enabled.
+ */
+SensorBase* sensors_poll_context_t::openDriver(int index)
+{
+    mReleaseAt[index] = 0;
+    if (mSensors[index])
+        return mSensors[index];
+
+    SENSOR_TRACE_BEGIN("openDriver");
+    switch (index) {
+        case bma250:
+            mSensors[index] = new (mSlots[index]) BMA250Sensor(&mArbiter);
+            break;
+        case als22x7:
+            mSensors[index] = new (mSlots[index]) STK_ALS22x7Sensor(&mArbiter);
+            break;
+    }
+    mPollFds[index].fd = mSensors[index]->getFd();
+    mPollFds[index].revents = 0;
+    watchFd(index, EPOLL_CTL_ADD, false);
+    mWakeUpArmed[index] = false;
+    SENSOR_TRACE_END();
+    ALOGD("opened sensor driver %d (fd %d)", index, mPollFds[index].fd);
+    return mSensors[index];
+}
+
+void sensors_poll_context_t::releaseDriver(int index)
+{
+    watchFd(index, EPOLL_CTL_DEL, false);
+    mTimers.cancel(&mDriverTimers[index]);
+    mSensors[index]->~SensorBase();
+    mSensors[index] = NULL;
+    mPollFds[index].fd = -1;
+    mPollFds[index].revents = 0;
+    mWakeUpArmed[index] = false;
+    mReleaseAt[index] = 0;
+    ALOGD("released sensor driver %d", index);
+}
+
+/*
+ * Poll thread only, after the drivers were brought up to date: open
+ * drivers left without an enabled handle are given RELEASE_DELAY_NS in
+ * case they are wanted again, e.g. across a screen rotation.
+ */
+void sensors_poll_context_t::scheduleReleases()
+{
+    int64_t now = 0;
+    int64_t next = 0;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        if (!mSensors[i] || (mActive & mDriverHandles[i]) || !mSensors[i]->canRelease()) {
+            mReleaseAt[i] = 0;
+            continue;
+        }
+        if (!mReleaseAt[i]) {
+            if (!now) {
+                now = SensorBase::getTimestamp();
+            }
+            mReleaseAt[i] = now + RELEASE_DELAY_NS;
+        }
+        if (!next || mReleaseAt[i] < next) {
+            next = mReleaseAt[i];
+        }
+    }
+    mTimers.schedule(&mReleaseTimer, next);
+}
+
+void sensors_poll_context_t::onReleaseTimer(void* cookie, int64_t)
+{
+    static_cast<sensors_poll_context_t*>(cookie)->releaseIdleDrivers();
+}
+
+void sensors_poll_context_t::releaseIdleDrivers()
+{
+    int64_t now = SensorBase::getTimestamp();
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        if (mReleaseAt[i] && now >= mReleaseAt[i]) {
+            releaseDriver(i);
+        }
+    }
+    scheduleReleases();
+}
+
+int64_t sensors_poll_context_t::stallTimeout(int index) const
+{
+    if (!mSensors[index])
+        return 0;
+    int64_t period = mSensors[index]->getWatchdogPeriod();
+    if (!period)
+        return 0;
+    period *= WATCHDOG_PERIODS;
+    return period < WATCHDOG_MIN_NS ? WATCHDOG_MIN_NS : period;
 }
 
+/*
+ * The watchdog costs nothing per event: input arrival is stamped once per
+ * wakeup in waitForEvents(), which moves the timer to the earliest stall
+ * deadline.
+ */
+void sensors_poll_context_t::scheduleWatchdog()
+{
+    int64_t next = 0;
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        int64_t timeout = stallTimeout(i);
+        if (!timeout)
+            continue;
+        int64_t deadline = mLastInput[i] + timeout;
+        if (!next || deadline < next) {
+            next = deadline;
+        }
+    }
+    mTimers.schedule(&mWatchdogTimer, next);
+}
+
+void sensors_poll_context_t::onWatchdogTimer(void* cookie, int64_t)
+{
+    static_cast<sensors_poll_context_t*>(cookie)->checkWatchdog();
+}
+
+void sensors_poll_context_t::checkWatchdog()
+{
+    int64_t now = SensorBase::getTimestamp();
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        int64_t timeout = stallTimeout(i);
+        if (!timeout || now - mLastInput[i] < timeout)
+            continue;
+
+        mRecoveries++;
+        ALOGW("sensor driver %d stalled for %lldms, recovering (%u so far)",
+                i, (long long)((now - mLastInput[i]) / 1000000), mRecoveries);
+        SENSOR_TRACE_INT("watchdog recoveries", mRecoveries);
+
+        watchFd(i, EPOLL_CTL_DEL, false);
+        int err = mSensors[i]->recover();
+        ALOGE_IF(err, "sensor driver %d recovery failed (%s)", i, strerror(-err));
+        mPollFds[i].fd = mSensors[i]->getFd();
+        mPollFds[i].revents = 0;
+        watchFd(i, EPOLL_CTL_ADD, false);
+        // a new fd starts without its wakeup source
+        mWakeUpArmed[i] = false;
+        mLastInput[i] = now;
+    }
+    armWakeUp();
+    scheduleWatchdog();
+}
+
+void sensors_poll_context_t::watchFd(int index, int op, bool wakeUp)
+{
+    if (mPollFds[index].fd < 0)
+        return;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    if (wakeUp) {
+        event.events |= EPOLLWAKEUP;
+    }
+    event.data.u32 = index;
+    int result = epoll_ctl(mEpollFd, op, mPollFds[index].fd, &event);
+    ALOGE_IF(result<0, "error watching fd %d (%s)", mPollFds[index].fd, strerror(errno));
+}
+
+static bool waitFor(const char* file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return false;
+    char c;
+    int err;
+    do {
+        err = read(fd, &c, 1);
+    } while (err < 0 && errno == EINTR);
+    close(fd);
+    return err >= 0;
+}
+
+/*
+ * Non-wake-up sensors are paused across suspend. The 3.0 kernel only
+ * tells userspace about early suspend, after which the system suspends as
+ * soon as no wakelock is held, so that is when they go off. One thread
+ * per process blocks on the sysfs files and posts each transition on the
+ * wake pipe of every open context. A blocked read can't be interrupted
+ * without a signal, so that thread lives as long as the process, as in
+ * libsuspend; contexts come and go from its list.
+ */
+static pthread_once_t sSuspendOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t sSuspendLock = PTHREAD_MUTEX_INITIALIZER;
+static sensors_poll_context_t* sSuspendListeners;  // under sSuspendLock
+static bool sScreenOff;                             // under sSuspendLock
+
+void sensors_poll_context_t::listenForSuspend()
+{
+    mNextSuspendListener = NULL;
+    if (access(WAIT_FOR_FB_SLEEP_FILE, R_OK) || access(WAIT_FOR_FB_WAKE_FILE, R_OK)) {
+        ALOGD("no early suspend, non-wake-up sensors keep running in suspend");
+        return;
+    }
+
+    pthread_once(&sSuspendOnce, startSuspendThread);
+    pthread_mutex_lock(&sSuspendLock);
+    mNextSuspendListener = sSuspendListeners;
+    sSuspendListeners = this;
+    if (sScreenOff) {
+        // opened while the screen is off
+        const char suspendMessage(SUSPEND_MESSAGE);
+        write(mWritePipeFd, &suspendMessage, 1);
+    }
+    pthread_mutex_unlock(&sSuspendLock);
+}
+
+// before the wake pipe is closed, so the thread never writes to a reused fd
+void sensors_poll_context_t::stopListeningForSuspend()
+{
+    pthread_mutex_lock(&sSuspendLock);
+    for (sensors_poll_context_t** p = &sSuspendListeners ; *p ; p = &(*p)->mNextSuspendListener) {
+        if (*p == this) {
+            *p = mNextSuspendListener;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sSuspendLock);
+}
+
+void sensors_poll_context_t::startSuspendThread()
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, suspendThread, NULL);
+    ALOGE_IF(err, "couldn't start the suspend thread (%s)", strerror(err));
+    pthread_attr_destroy(&attr);
+}
+
+void sensors_poll_context_t::postSuspend(bool suspended)
+{
+    const char message(suspended ? SUSPEND_MESSAGE : RESUME_MESSAGE);
+    pthread_mutex_lock(&sSuspendLock);
+    sScreenOff = suspended;
+    for (sensors_poll_context_t* ctx = sSuspendListeners ; ctx ; ctx = ctx->mNextSuspendListener) {
+        write(ctx->mWritePipeFd, &message, 1);
+    }
+    pthread_mutex_unlock(&sSuspendLock);
+}
+
+void* sensors_poll_context_t::suspendThread(void*)
+{
+    while (waitFor(WAIT_FOR_FB_SLEEP_FILE)) {
+        postSuspend(true);
+        if (!waitFor(WAIT_FOR_FB_WAKE_FILE))
+            break;
+        postSuspend(false);
+    }
+    ALOGE("lost track of early suspend (%s)", strerror(errno));
+    return NULL;
+}
+
+const char* sensors_poll_context_t::enableFile(int index)
+{
+    return index == bma250 ? BMA250_ENABLE_FILE : STK_ALS22X7_ENABLE_FILE;
+}
+
+// atomically clears an int32_t, with acquire semantics
+static int32_t takeValue(volatile int32_t* value)
+{
+    int32_t old;
+    do {
+        old = android_atomic_acquire_load(value);
+    } while (android_atomic_acquire_cas(old, 0, value));
+    return old;
+}
+
+/*
+ * Returns without waiting for the poll thread, which may be the caller's
+ * own or blocked on a lock the caller holds. An enable node that can't
+ * be opened for writing fails the call right away. Anything the driver
+ * refuses later fails the next activate() of the handle, which is still
+ * applied.
+ */
 int sensors_poll_context_t::activate(int handle, int enabled) {
     int index = handleToDriver(handle);
     ALOGD("sensor activation called: handle=%d, enabled=%d********************************", handle, enabled);
     if (index < 0) return index;
-    int err =  mSensors[index]->enable(handle, enabled);
-    if (enabled && !err) {
-        const char wakeMessage(WAKE_MESSAGE);
-        int result = write(mWritePipeFd, &wakeMessage, 1);
-        ALOGE_IF(result<0, "error sending wake message (%s)", strerror(errno));
+    if (enabled) {
+        int fd = open(enableFile(index), O_WRONLY);
+        if (fd < 0) {
+            int err = -errno;
+            ALOGE("couldn't enable handle %d (%s)", handle, strerror(errno));
+            return err;
+        }
+        close(fd);
+        android_atomic_or(1 << handle, &mEnableRequest);
+    } else {
+        android_atomic_and(~(1 << handle), &mEnableRequest);
     }
-    return err;
+    android_atomic_or(1 << handle, &mEnableDirty);
+    wakePollThread();
+    return takeValue(&mEnableError[handle]);
 }
 
 int sensors_poll_context_t::setDelay(int handle, int64_t ns) {
 
     int index = handleToDriver(handle);
     if (index < 0) return index;
-    return mSensors[index]->setDelay(handle, ns);
+    if (ns < 0) return -EINVAL;
+    int64_t us = ns / 1000;
+    android_atomic_release_store(us > 0x7fffffff ? 0x7fffffff : int32_t(us), &mDelayUs[handle]);
+    android_atomic_or(1 << handle, &mDelayDirty);
+    wakePollThread();
+    return 0;
+}
+
+void sensors_poll_context_t::wakePollThread()
+{
+    const char wakeMessage(WAKE_MESSAGE);
+    int result = write(mWritePipeFd, &wakeMessage, 1);
+    // a full pipe means a wakeup is already pending
+    ALOGE_IF(result<0 && errno != EAGAIN, "error sending wake message (%s)", strerror(errno));
 }
 
+/*
+ * Only the accelerometer can batch. The period goes the way of setDelay(),
+ * the timeout is published alongside it and applied with it.
+ */
+int sensors_poll_context_t::batch(int handle, int flags, int64_t period_ns, int64_t timeout)
+{
+    int index = handleToDriver(handle);
+    if (index < 0)
+        return index;
+    if (timeout < 0)
+        return -EINVAL;
+    if (timeout > 0 && (handle & (ID_WAKE_UP - 1)) != ID_A)
+        return -EINVAL;
+    if (flags & SENSORS_BATCH_DRY_RUN)
+        return 0;
+
+    int64_t us = timeout / 1000;
+    android_atomic_release_store(us > 0x7fffffff ? 0x7fffffff : int32_t(us), &mBatchUs[handle]);
+    return setDelay(handle, period_ns);
+}
+
+/*
+ * Poll thread only. Brings the drivers in line with the latest requested
+ * state; requests that were overwritten before we got here are simply
+ * never seen, only the final state matters.
+ *
+ * Both flavours of a sensor share the driver's base handle: it is enabled
+ * while either is, at the fastest delay of the enabled ones. While the
+ * system sleeps the paused handles count as disabled.
+ */
+void sensors_poll_context_t::applyRequests()
+{
+    int32_t enableDirty = takeValue(&mEnableDirty);
+    int32_t delayDirty = takeValue(&mDelayDirty);
+    int32_t enabled = android_atomic_acquire_load(&mEnableRequest);
+    if (mSuspended) {
+        enabled &= ~SUSPEND_PAUSED_HANDLES;
+    }
+    int32_t touched = 0;        // drivers that were told something
+
+    for (int handle=0 ; handle<maxHandles ; handle++) {
+        const int32_t bit = 1 << handle;
+        if (!((enableDirty | delayDirty) & bit))
+            continue;
+        int index = handleToDriver(handle);
+        if (index < 0)
+            continue;
+
+        const int base = handle & (ID_WAKE_UP - 1);
+        const int32_t flavours = (1 << base) | (1 << (base + ID_WAKE_UP));
+        if (!mSensors[index] && !(enabled & flavours)) {
+            // nothing to tell a driver that was never needed
+            continue;
+        }
+        SensorBase* const sensor(openDriver(index));
+        int32_t us = fastestDelay(base, enabled);
+        if (enableDirty & bit) {
+            int err = sensor->enable(base, (enabled & flavours) ? 1 : 0);
+            touched |= 1 << index;
+            ALOGE_IF(err, "couldn't %s handle %d (%s)",
+                    (enabled & bit) ? "enable" : "disable", handle, strerror(-err));
+            if (err) {
+                android_atomic_release_store(err, &mEnableError[handle]);
+            } else {
+                mActive = (mActive & ~bit) | (enabled & bit);
+                // drivers ignore the delay while disabled, so replay it
+                delayDirty |= bit;
+            }
+        }
+        if ((delayDirty & bit) && us >= 0) {
+            sensor->setDelay(base, int64_t(us) * 1000);
+            sensor->setBatchTimeout(base, int64_t(shortestBatch(base, enabled)) * 1000);
+            touched |= 1 << index;
+        }
+    }
+
+    armWakeUp();
+    scheduleReleases();
+
+    // restart the clock on what may have been reprogrammed, only: a
+    // stalled driver must not escape the watchdog through another's requests
+    int64_t now = SensorBase::getTimestamp();
+    updateStats(now);
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        if (touched & (1 << i)) {
+            mLastInput[i] = now;
+        }
+    }
+    scheduleWatchdog();
+}
+
+int32_t sensors_poll_context_t::fastestDelay(int base, int32_t enabled) const
+{
+    int32_t us = -1;
+    for (int handle=base ; handle<maxHandles ; handle+=ID_WAKE_UP) {
+        int32_t d = android_atomic_acquire_load(&mDelayUs[handle]);
+        if ((enabled & (1 << handle)) && d >= 0 && (us < 0 || d < us)) {
+            us = d;
+        }
+    }
+    return us;
+}
+
+// a flavour that wants its events right away wins
+int32_t sensors_poll_context_t::shortestBatch(int base, int32_t enabled) const
+{
+    int32_t us = -1;
+    for (int handle=base ; handle<maxHandles ; handle+=ID_WAKE_UP) {
+        int32_t t = android_atomic_acquire_load(&mBatchUs[handle]);
+        if ((enabled & (1 << handle)) && (us < 0 || t < us)) {
+            us = t;
+        }
+    }
+    return us < 0 ? 0 : us;
+}
+
+/*
+ * A driver serving an enabled wake-up sensor keeps the system awake from
+ * the moment its input arrives until it has been read: EPOLLWAKEUP where
+ * the kernel has it, the evdev suspend blocker on older Android kernels.
+ * Every other driver explicitly holds neither, so it pauses with the
+ * system instead of keeping it up.
+ */
+void sensors_poll_context_t::armWakeUp()
+{
+    bool wanted[numSensorDrivers];
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        wanted[i] = false;
+    }
+
+    // one-shot sensors are wake-up sensors by definition
+    const int32_t wakeUp = (mActive >> ID_WAKE_UP) | (mActive & ONE_SHOT_HANDLES);
+    for (int base=0 ; base<ID_WAKE_UP ; base++) {
+        int index = handleToDriver(base);
+        if ((wakeUp & (1 << base)) && index >= 0) {
+            wanted[index] = true;
+        }
+    }
+
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        if (wanted[i] == mWakeUpArmed[i] || mPollFds[i].fd < 0)
+            continue;
+        watchFd(i, EPOLL_CTL_MOD, wanted[i]);
+        int block = wanted[i] ? 1 : 0;
+        ioctl(mPollFds[i].fd, EVIOCSSUSPENDBLOCK, &block);
+        mWakeUpArmed[i] = wanted[i];
+    }
+}
+
+/*
+ * A one-shot sensor has turned itself off in its driver once it fired,
+ * and the framework of this Android version never deactivates it: drop
+ * it here, or it would keep its driver armed for wakeups and unreleased,
+ * and be billed as active from then on.
+ */
+void sensors_poll_context_t::retireOneShots(int32_t fired)
+{
+    android_atomic_and(~fired, &mEnableRequest);
+    mActive &= ~fired;
+    armWakeUp();
+    scheduleReleases();
+    updateStats(SensorBase::getTimestamp());
+}
+
+/*
+ * Poll thread only, once mActive or the delays may have changed. The
+ * other instances learn what is active here to split the charge. The
+ * file is only written once a minute or on request, a handle going off
+ * leaves its last interval in the totals for the next dump.
+ */
+void sensors_poll_context_t::updateStats(int64_t now)
+{
+    const int32_t previous = mStats.getActive();
+    mStats.update(now, mActive, mDelayUs);
+    if (mActive != previous) {
+        mArbiter.setActive(mActive);
+    }
+}
+
+void sensors_poll_context_t::dumpStats(int64_t now)
+{
+    int64_t shareNs[SensorArbiter::MAX_HANDLES];
+    mArbiter.getShares(shareNs);
+    mStats.dump(now, shareNs);
+}
+
+/*
+ * Drivers report their base handles. Events of a sensor whose wake-up
+ * flavour is enabled are relabelled, or duplicated when both flavours are
+ * enabled, in which case the caller left room for twice as many.
+ */
+int sensors_poll_context_t::routeFlavours(sensors_event_t* data, int count)
+{
+    const int32_t wakeUp = mActive >> ID_WAKE_UP;
+
+    int32_t fired = 0;
+    for (int i=0 ; i<count ; i++) {
+        fired |= ONE_SHOT_HANDLES & (1 << data[i].sensor);
+    }
+    if (fired) {
+        // one-shot sensors are wake-up sensors by definition
+        mWakeUpPending = true;
+        retireOneShots(fired);
+    }
+
+    if (!wakeUp) {
+        return count;
+    }
+
+    int total = count;
+    for (int i=0 ; i<count ; i++) {
+        const int32_t bit = 1 << data[i].sensor;
+        if ((wakeUp & bit) && (mActive & bit)) {
+            total++;
+        }
+    }
+
+    // expand from the back so nothing is overwritten before it is copied
+    int out = total;
+    for (int i=count-1 ; i>=0 ; i--) {
+        const sensors_event_t event(data[i]);
+        const int32_t bit = 1 << event.sensor;
+        if (wakeUp & bit) {
+            data[--out] = event;
+            data[out].sensor = event.sensor + ID_WAKE_UP;
+            mWakeUpPending = true;
+        }
+        if (!(wakeUp & bit) || (mActive & bit)) {
+            data[--out] = event;
+        }
+    }
+    return total;
+}
+
+int sensors_poll_context_t::waitForEvents(int timeout)
+{
+    struct epoll_event events[numFds];
+    int n = epoll_wait(mEpollFd, events, numFds, timeout);
+    int64_t now = n > 0 && mWatchdogTimer.isPending() ? SensorBase::getTimestamp() : 0;
+    for (int i=0 ; i<n ; i++) {
+        const uint32_t index = events[i].data.u32;
+        mPollFds[index].revents = events[i].events;
+        if (now && index < numSensorDrivers) {
+            mLastInput[index] = now;
+        }
+    }
+    if (now) {
+        scheduleWatchdog();
+    }
+    return n;
+}
+
+/*
+ * Driver deadlines move with every event, so they are handed to the wheel
+ * just before blocking, which costs nothing when they didn't change. Their
+ * timers have no callback: waking up is enough for the next pass of the
+ * loop to find hasPendingEvents() true.
+ */
+void sensors_poll_context_t::scheduleDeadlines()
+{
+    for (int i=0 ; i<numSensorDrivers ; i++) {
+        mTimers.schedule(&mDriverTimers[i], mSensors[i] ? mSensors[i]->getDeadline() : 0);
+    }
+}
+
+#ifdef SENSORS_TRACE
+/*
+ * Once a second, publishes how many events each handle delivered as a
+ * "rate <handle>" counter track.
+ */
+void sensors_poll_context_t::traceRates(sensors_event_t const* data, int count)
+{
+    if (!SENSOR_TRACE_ENABLED())
+        return;
+
+    int64_t now = SensorBase::getTimestamp();
+    for (int i=0 ; i<count ; i++) {
+        if (data[i].sensor >= 0 && data[i].sensor < maxHandles) {
+            mTraceEvents[data[i].sensor]++;
+        }
+        mTraceLatency[SensorStats::latencyBucket(now - data[i].timestamp)]++;
+    }
+
+    if (now - mTraceStart < 1000000000LL)
+        return;
+    for (int handle=0 ; handle<maxHandles ; handle++) {
+        if (handleToDriver(handle) >= 0) {
+            char name[16];
+            snprintf(name, sizeof(name), "rate %d", handle);
+            SENSOR_TRACE_INT(name, mTraceEvents[handle]);
+        }
+    }
+
+    // upper bound of the buckets holding the median and the 99th percentile
+    int p50 = SensorStats::percentile(mTraceLatency, 50);
+    if (p50 >= 0) {
+        SENSOR_TRACE_INT("latency p50 us", SensorStats::latencyBound(p50));
+        int p99 = SensorStats::percentile(mTraceLatency, 99);
+        SENSOR_TRACE_INT("latency p99 us", SensorStats::latencyBound(p99));
+    }
+
+    memset(mTraceEvents, 0, sizeof(mTraceEvents));
+    memset(mTraceLatency, 0, sizeof(mTraceLatency));
+    mTraceStart = now;
+}
+#endif
+
 int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
 {
     int nbEvents = 0;
     int n = 0;
+    int timeout = -1;
+
+    mPolicy.apply();
+    SENSOR_TRACE_BEGIN("pollEvents");
 
     do {
+        // two loads when nothing changed, which is nearly always
+        if (android_atomic_acquire_load(&mEnableDirty) |
+                android_atomic_acquire_load(&mDelayDirty)) {
+            applyRequests();
+        }
+
         // see if we have some leftover from the last poll()
         for (int i=0 ; count && i<numSensorDrivers ; i++) {
             SensorBase* const sensor(mSensors[i]);
+            if (!sensor)
+                continue;
             if ((mPollFds[i].revents & POLLIN) || (sensor->hasPendingEvents())) {
-                int nb = sensor->readEvents(data, count);
-                if (nb < count) {
+                // sensors enabled in both flavours report every event twice
+                int room = (mActive & (mActive >> ID_WAKE_UP)) ? count / 2 : count;
+                if (!room) {
+                    count = 0;
+                    break;
+                }
+                int nb = sensor->readEvents(data, room);
+                if (nb < room) {
                     // no more data for this sensor
                     mPollFds[i].revents = 0;
                 }
+                nb = routeFlavours(data, nb);
                 count -= nb;
                 nbEvents += nb;
                 data += nb;
@@ -145,32 +979,89 @@ int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
             // we still have some room, so try to see if we can get
             // some events immediately or just wait if we don't have
             // anything to return
-            n = poll(mPollFds, numFds, nbEvents ? 0 : -1);
+            scheduleDeadlines();
+            timeout = nbEvents ? 0 : -1;
+            if (timeout && mWakeLockHeld) {
+                // the events that needed it have been consumed by now
+                release_wake_lock(WAKE_LOCK_ID);
+                mWakeLockHeld = false;
+            }
+            SENSOR_TRACE_BEGIN("poll");
+            n = waitForEvents(timeout);
+            SENSOR_TRACE_END();
             if (n<0) {
-                ALOGE("poll() failed (%s)", strerror(errno));
-                return -errno;
+                int err = -errno;
+                ALOGE("epoll_wait() failed (%s)", strerror(errno));
+                SENSOR_TRACE_END();
+                return err;
             }
             if (mPollFds[wake].revents & POLLIN) {
-                char msg;
-                int result = read(mPollFds[wake].fd, &msg, 1);
+                // drain every queued wakeup, the requests are applied above
+                char msg[16];
+                int result = read(mPollFds[wake].fd, msg, sizeof(msg));
                 ALOGE_IF(result<0, "error reading from wake pipe (%s)", strerror(errno));
-                ALOGE_IF(msg != WAKE_MESSAGE, "unknown message on wake queue (0x%02x)", int(msg));
+                for (int i=0 ; i<result ; i++) {
+                    if (msg[i] == SUSPEND_MESSAGE || msg[i] == RESUME_MESSAGE) {
+                        mSuspended = msg[i] == SUSPEND_MESSAGE;
+                        android_atomic_or(SUSPEND_PAUSED_HANDLES, &mEnableDirty);
+                        continue;
+                    }
+                    ALOGE_IF(msg[i] != WAKE_MESSAGE, "unknown message on wake queue (0x%02x)", int(msg[i]));
+                }
+                SENSOR_TRACE_INT("wakeups", result);
                 mPollFds[wake].revents = 0;
             }
+            if (mPollFds[timer].revents & POLLIN) {
+                mTimers.expire();
+                mPollFds[timer].revents = 0;
+            }
+            if (mPollFds[stats].revents & POLLIN) {
+                if (SensorStats::takeRequests(mPollFds[stats].fd)) {
+                    dumpStats(SensorBase::getTimestamp());
+                }
+                mPollFds[stats].revents = 0;
+            }
         }
-        // if we have events and space, go read them
+        // if we have events and space, or a deadline expired, go read them
     } while (n && count);
 
+    // stay awake until the caller comes back for more, i.e. has consumed them
+    if (mWakeUpPending) {
+        if (!mWakeLockHeld) {
+            acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
+            mWakeLockHeld = true;
+        }
+        mWakeUpPending = false;
+    }
+
+    const int64_t now = SensorBase::getTimestamp();
+    mStats.countEvents(data - nbEvents, nbEvents, now);
+    if (mStats.isDumpDue(now)) {
+        dumpStats(now);
+    }
+
+    SENSOR_TRACE_INT("events", nbEvents);
+#ifdef SENSORS_TRACE
+    traceRates(data - nbEvents, nbEvents);
+#endif
+    SENSOR_TRACE_END();
     return nbEvents;
 }
 
+void sensors_poll_context_t::setSensorList(struct sensor_t const* list, int count)
+{
+    mStats.setSensors(list, count);
+}
+
 /*****************************************************************************/
 
 static int poll__close(struct hw_device_t *dev)
 {
     sensors_poll_context_t *ctx = (sensors_poll_context_t *)dev;
     if (ctx) {
-        delete ctx;
+        // the context sits at the start of its own arena
+        ctx->~sensors_poll_context_t();
+        free(ctx);
     }
     return 0;
 }
@@ -193,22 +1084,50 @@ static int poll__poll(struct sensors_poll_device_t *dev,
     return ctx->pollEvents(data, count);
 }
 
+static int poll__batch(struct sensors_poll_device_1 *dev,
+        int handle, int flags, int64_t period_ns, int64_t timeout) {
+    sensors_poll_context_t *ctx = (sensors_poll_context_t *)dev;
+    return ctx->batch(handle, flags, period_ns, timeout);
+}
+
 /*****************************************************************************/
 
-int init_nusensors(hw_module_t const* module, hw_device_t** device)
+int init_nusensors(hw_module_t const* module, hw_device_t** device, int primary)
 {
     int status = -EINVAL;
 
-    sensors_poll_context_t *dev = new sensors_poll_context_t();
-    memset(&dev->device, 0, sizeof(sensors_poll_device_t));
+    /*
+     * The context and the drivers live in here, so the event path never
+     * allocates. The rest of the HAL still does, off that path: building
+     * a driver scans /dev/input and reads its rate table through stdio,
+     * the BMA250 opens the lights HAL for face-down blanking, the stats
+     * are written through stdio, and the first open starts the suspend
+     * thread.
+     */
+    size_t size = sensors_poll_context_t::arenaSize();
+    void* block = memalign(SensorArena::CACHE_LINE, size);
+    if (!block) {
+        return -ENOMEM;
+    }
+    SensorArena arena(block, size);
+
+    sensors_poll_context_t *dev = new (arena.alloc(sizeof(sensors_poll_context_t)))
+            sensors_poll_context_t(arena, primary != 0);
+    memset(&dev->device, 0, sizeof(sensors_poll_device_1_t));
+
+    struct sensors_module_t* sensors = (struct sensors_module_t*)module;
+    struct sensor_t const* list;
+    int count = sensors->get_sensors_list(sensors, &list);
+    dev->setSensorList(list, count);
 
     dev->device.common.tag = HARDWARE_DEVICE_TAG;
-    dev->device.common.version  = 0;
+    dev->device.common.version  = SENSORS_DEVICE_API_VERSION_1_0;
     dev->device.common.module   = const_cast<hw_module_t*>(module);
     dev->device.common.close    = poll__close;
     dev->device.activate        = poll__activate;
     dev->device.setDelay        = poll__setDelay;
     dev->device.poll            = poll__poll;
+    dev->device.batch           = poll__batch;
 
     *device = &dev->device.common;
     status = 0;
@@ -31,14 +31,49 @@ __BEGIN_DECLS
 
 /*****************************************************************************/
 
-int init_nusensors(hw_module_t const* module, hw_device_t** device);
+int init_nusensors(hw_module_t const* module, hw_device_t** device, int primary);
+int bma250_min_delay_us(void);
 
 /*****************************************************************************/
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
 
+/*
+ * Host builds point every file the HAL uses at stand-ins, e.g.
+ * -DSENSORS_ROOT=\"/tmp/sensors\" with the same tree below it.
+ */
+#ifndef SENSORS_ROOT
+#define SENSORS_ROOT ""
+#endif
+
+/*
+ * Device name sensorhubd opens the HAL with. Its instance shares the
+ * hardware with the framework's, see SensorArbiter, and leaves the
+ * framework's to act on the rest of the system.
+ */
+#define SENSORS_HARDWARE_POLL_SECONDARY "poll.secondary"
+
 #define ID_A	(0)
 #define ID_B	(1)
+#define ID_SM	(2)
+#define ID_SD	(3)
+#define ID_SC	(4)
+#define ID_FD	(5)
+#define ID_SK	(6)
+#define ID_DT	(7)
+
+// fire once and disable themselves, and always wake the system up
+#define ONE_SHOT_HANDLES	((1 << ID_SM) | (1 << ID_SK) | (1 << ID_DT))
+
+// added to a handle for the wake-up flavour of the same sensor
+#define ID_WAKE_UP	(16)
+
+// non-wake-up flavours switched off while the system sleeps; the step
+// sensors keep counting, they would lose steps otherwise
+#define SUSPEND_PAUSED_HANDLES	((1 << ID_A) | (1 << ID_B) | (1 << ID_FD))
+
+// accelerometer samples the HAL can hold while batching
+#define BMA250_FIFO_EVENTS	(1024)
 
 /*****************************************************************************/
 
@@ -55,6 +90,11 @@ int init_nusensors(hw_module_t const* module, hw_device_t** device);
 #define EVENT_TYPE_ACCEL_Z          ABS_Z
 #define EVENT_TYPE_ACCEL_STATUS     ABS_WHEEL
 
+// older kernel headers predate it
+#ifndef SYN_DROPPED
+#define SYN_DROPPED                 3
+#endif
+
 // 256LSG/G
 #define LSG                         (256.0f)
 
@@ -67,6 +107,12 @@ int init_nusensors(hw_module_t const* module, hw_device_t** device);
 
 #define SENSOR_STATE_MASK           (0x7FFF)
 
+// no standard type for it, data[0] is 1 while the screen faces down
+#define SENSOR_TYPE_FACE_DOWN       (0x10000 + 1)
+// one-shot, data[0] is 1
+#define SENSOR_TYPE_SHAKE           (0x10000 + 2)
+#define SENSOR_TYPE_DOUBLE_TAP      (0x10000 + 3)
+
 /*****************************************************************************/
 
 __END_DECLS
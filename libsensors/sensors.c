@@ -15,6 +15,8 @@
  */
 
 #include <hardware/sensors.h>
+#include <pthread.h>
+#include <string.h>
 
 #include "nusensors.h"
 
@@ -24,7 +26,8 @@
  * The SENSORS Module
  */
 
-static const struct sensor_t sSensorList[] = {
+/* accelerometer minDelays are filled in from the measured rates */
+static struct sensor_t sSensorList[] = {
         {
 		.name		= "BMA250 3-axis Accelerometer",
 		.vendor		= "Bosch Sensortec GmbH",
@@ -35,6 +38,8 @@ static const struct sensor_t sSensorList[] = {
 		.resolution	= (16.0f*GRAVITY_EARTH)/4096,
 		.power		= 0.003f,
 		.minDelay	= 0,
+		.fifoReservedEventCount	= BMA250_FIFO_EVENTS,
+		.fifoMaxEventCount	= BMA250_FIFO_EVENTS,
 		.reserved	= { }
 	},
         {
@@ -49,14 +54,154 @@ static const struct sensor_t sSensorList[] = {
 		.minDelay	= 0,
 		.reserved	= { }
 	},
+        {
+		.name		= "Significant Motion Detector",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_SM,
+		.type		= SENSOR_TYPE_SIGNIFICANT_MOTION,
+		.maxRange	= 1.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= -1,	/* one-shot */
+		.reserved	= { }
+	},
+        {
+		.name		= "Step Detector",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_SD,
+		.type		= SENSOR_TYPE_STEP_DETECTOR,
+		.maxRange	= 1.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= 0,
+		.reserved	= { }
+	},
+        {
+		.name		= "Step Counter",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_SC,
+		.type		= SENSOR_TYPE_STEP_COUNTER,
+		.maxRange	= 4294967295.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= 0,
+		.reserved	= { }
+	},
+        {
+		.name		= "Face Down Detector",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_FD,
+		.type		= SENSOR_TYPE_FACE_DOWN,
+		.maxRange	= 1.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= 0,
+		.reserved	= { }
+	},
+        {
+		.name		= "Shake Detector",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_SK,
+		.type		= SENSOR_TYPE_SHAKE,
+		.maxRange	= 1.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= -1,	/* one-shot */
+		.reserved	= { }
+	},
+        {
+		.name		= "Double Tap Detector",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_DT,
+		.type		= SENSOR_TYPE_DOUBLE_TAP,
+		.maxRange	= 1.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= -1,	/* one-shot */
+		.reserved	= { }
+	},
+	/* wake-up flavours, see sensors_poll_context_t::routeFlavours() */
+        {
+		.name		= "BMA250 3-axis Accelerometer (wake-up)",
+		.vendor		= "Bosch Sensortec GmbH",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_WAKE_UP+ID_A,
+		.type		= SENSOR_TYPE_ACCELEROMETER,
+		.maxRange	= (16.0f*GRAVITY_EARTH),
+		.resolution	= (16.0f*GRAVITY_EARTH)/4096,
+		.power		= 0.003f,
+		.minDelay	= 0,
+		.fifoReservedEventCount	= BMA250_FIFO_EVENTS,
+		.fifoMaxEventCount	= BMA250_FIFO_EVENTS,
+		.reserved	= { }
+	},
+        {
+		.name		= "SensorTek 22x7 Ambient Light Sensor (wake-up)",
+		.vendor		= "SensorTek",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_WAKE_UP+ID_B,
+		.type		= SENSOR_TYPE_LIGHT,
+		.maxRange	= 8192.0f,
+		.resolution	= 1.0f,
+		.power		= 0.5f,
+		.minDelay	= 0,
+		.reserved	= { }
+	},
+        {
+		.name		= "Step Detector (wake-up)",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_WAKE_UP+ID_SD,
+		.type		= SENSOR_TYPE_STEP_DETECTOR,
+		.maxRange	= 1.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= 0,
+		.reserved	= { }
+	},
+        {
+		.name		= "Step Counter (wake-up)",
+		.vendor		= "AOSP",
+		.version	= 1,
+		.handle		= SENSORS_HANDLE_BASE+ID_WAKE_UP+ID_SC,
+		.type		= SENSOR_TYPE_STEP_COUNTER,
+		.maxRange	= 4294967295.0f,
+		.resolution	= 1.0f,
+		.power		= 0.003f,
+		.minDelay	= 0,
+		.reserved	= { }
+	},
 };
 
 static int open_sensors(const struct hw_module_t* module, const char* name,
         struct hw_device_t** device);
 
+static pthread_once_t sSensorListOnce = PTHREAD_ONCE_INIT;
+
+static void init_sensors_list(void)
+{
+    int minDelay = bma250_min_delay_us();
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(sSensorList); i++) {
+        if (sSensorList[i].type == SENSOR_TYPE_ACCELEROMETER) {
+            sSensorList[i].minDelay = minDelay;
+        }
+    }
+}
+
 static int sensors__get_sensors_list(struct sensors_module_t* module,
         struct sensor_t const** list)
 {
+    /* the list is handed out as is, every caller waits for it to be done */
+    pthread_once(&sSensorListOnce, init_sensors_list);
+
     *list = sSensorList;
     return ARRAY_SIZE(sSensorList);
 }
@@ -83,5 +228,5 @@ struct sensors_module_t HAL_MODULE_INFO_SYM = {
 static int open_sensors(const struct hw_module_t* module, const char* name,
         struct hw_device_t** device)
 {
-    return init_nusensors(module, device);
+    return init_nusensors(module, device, strcmp(name, SENSORS_HARDWARE_POLL_SECONDARY) != 0);
 }
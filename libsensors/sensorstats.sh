@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Prints what the sensors HAL has accounted in every process that opened
+# it, most expensive handle first. The HAL writes its files once a minute
+# while its poll thread is up, when the process closes it, and right away
+# when the request file is touched, see SensorStats.h.
+#
+# usage: sensorstats.sh [adb options]
+
+dir=/data/system/sensors
+adb "$@" shell touch $dir/request
+sleep 1
+
+for f in $(adb "$@" shell ls $dir/ | tr -d '\r' | grep '\.stats$'); do
+	echo "== ${f%.stats}"
+	adb "$@" shell cat $dir/$f | tr -d '\r' > /tmp/sensorstats.$$
+	head -n 1 /tmp/sensorstats.$$
+	awk '
+		/^#/ { next }
+		{
+			name = $13
+			for (i = 14; i <= NF; i++) name = name " " $i
+			printf "%9.1f uAh %10.1f s %8u ev %6u wk  %s\n", $5, $2 / 1000, $3, $4, name
+		}' /tmp/sensorstats.$$ | sort -rn
+	# whatever the drivers add after the table
+	grep '^#' /tmp/sensorstats.$$ | grep -v '^# \(since\|handle\)'
+done
+rm -f /tmp/sensorstats.$$
@@ -0,0 +1,152 @@
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+
+LOCAL_PATH := $(call my-dir)
+
+storm_test_src_files := \
+	storm_test.cpp \
+	../sensors.c \
+	../nusensors.cpp \
+	../SensorBase.cpp \
+	../BMA250.cpp \
+	../STK-ALS22x7.cpp \
+	../AccelGovernor.cpp \
+	../SignificantMotion.cpp \
+	../StepCounter.cpp \
+	../FaceDown.cpp \
+	../GestureDetector.cpp \
+	../RateTable.cpp \
+	../RotationBoost.cpp \
+	../SensorStats.cpp \
+	../PollPolicy.cpp \
+	../TimerWheel.cpp \
+	../SensorArbiter.cpp \
+	../SensorTrace.cpp
+
+storm_test_c_includes := \
+	$(LOCAL_PATH)/.. \
+	hardware/libhardware/include \
+	hardware/libhardware_legacy/include
+
+# activate()/setDelay() storm against the poll thread, see storm_test.cpp.
+# Built with ThreadSanitizer; the HAL runs against a scratch tree.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_storm_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := $(storm_test_src_files)
+
+LOCAL_C_INCLUDES := $(storm_test_c_includes)
+
+LOCAL_CFLAGS := \
+	-DLOG_TAG=\"Sensors\" \
+	-DSENSORS_ROOT=\"/dev/shm/sensors_storm\" \
+	-fsanitize=thread
+
+LOCAL_LDFLAGS := -fsanitize=thread
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+
+LOCAL_LDLIBS := -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# The same storm with the trace points on, written to the host file sink in
+# SensorTrace.cpp and checked afterwards.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_trace_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := $(storm_test_src_files)
+
+LOCAL_C_INCLUDES := $(storm_test_c_includes)
+
+LOCAL_CFLAGS := \
+	-DLOG_TAG=\"Sensors\" \
+	-DSENSORS_ROOT=\"/dev/shm/sensors_trace\" \
+	-DSENSORS_TRACE \
+	-fsanitize=thread
+
+LOCAL_LDFLAGS := -fsanitize=thread
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+
+LOCAL_LDLIBS := -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# InputEventRing against the reader it replaced, see reader_bench.cpp.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_reader_bench
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := \
+	reader_bench.cpp \
+	InputEventCircularReader.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_CFLAGS := -DLOG_TAG=\"Sensors\"
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+
+LOCAL_LDLIBS := -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# Unit tests of the timer wheel, the FIFO and the detectors, see
+# unit_test.cpp. No poll thread; only the boost file lives in a scratch
+# tree.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensors_unit_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := \
+	unit_test.cpp \
+	timer_wheel_test.cpp \
+	accel_fifo_test.cpp \
+	significant_motion_test.cpp \
+	step_counter_test.cpp \
+	face_down_test.cpp \
+	gesture_detector_test.cpp \
+	rotation_boost_test.cpp \
+	../TimerWheel.cpp \
+	../SensorBase.cpp \
+	../SensorTrace.cpp \
+	../SignificantMotion.cpp \
+	../StepCounter.cpp \
+	../FaceDown.cpp \
+	../GestureDetector.cpp \
+	../RotationBoost.cpp
+
+LOCAL_C_INCLUDES := $(storm_test_c_includes)
+
+LOCAL_CFLAGS := \
+	-DLOG_TAG=\"Sensors\" \
+	-DSENSORS_ROOT=\"/dev/shm/sensors_unit\"
+
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+
+LOCAL_LDLIBS := -lrt -lm
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -16,6 +16,7 @@
 
 #include <stdint.h>
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <poll.h>
 
@@ -26,7 +27,7 @@
 
 #include <cutils/log.h>
 
-#include "InputEventReader.h"
+#include "InputEventCircularReader.h"
 
 /*****************************************************************************/
 
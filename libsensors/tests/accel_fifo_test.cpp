@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * AccelFifo delta encoding: timestamps come back within half a tick of
+ * what was pushed however long the FIFO runs, deltas that do not fit are
+ * clamped without losing the timestamps after them, and a full FIFO drops
+ * its oldest sample and keeps the right time for the next one.
+ */
+
+#include "AccelFifo.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+#define TICK_NS         int64_t(AccelFifo<4>::TICK_NS)
+#define MAX_DELTA_NS    (int64_t(AccelFifo<4>::MAX_DELTA) * TICK_NS)
+#define MS              1000000LL
+
+static void push(AccelFifo<4>& fifo, int value, int64_t timestamp)
+{
+    const int raw[3] = { value, -value, value * 2 };
+    fifo.push(raw, timestamp);
+}
+
+// the value pushed with it, and the timestamp
+static int pop(AccelFifo<4>& fifo, int64_t* timestamp)
+{
+    int raw[3];
+    fifo.pop(raw, timestamp);
+    EXPECT_EQ(raw[1], -raw[0]);
+    EXPECT_EQ(raw[2], raw[0] * 2);
+    return raw[0];
+}
+
+static void testRounding()
+{
+    AccelFifo<4> fifo;
+    int64_t popped;
+
+    // 100Hz with a jitter of a third of a tick, for long enough that
+    // rounding each delta on its own would be off by more than 100 ticks
+    const int64_t start = 1000 * MS;
+    int64_t pushed[3000];
+    int64_t worst = 0;
+    for (int i=0 ; i<3000 ; i++) {
+        pushed[i] = start + i * 10 * MS + (i % 3 - 1) * TICK_NS / 3;
+        push(fifo, i - 1500, pushed[i]);
+        // one left behind, so every pop goes through a delta
+        if (i > 0) {
+            EXPECT_EQ(pop(fifo, &popped), i - 1501);
+            const int64_t error = popped - pushed[i - 1];
+            if (error > worst || -error > worst) {
+                worst = error < 0 ? -error : error;
+            }
+        }
+    }
+    EXPECT(worst <= TICK_NS / 2);
+}
+
+static void testClamp()
+{
+    AccelFifo<4> fifo;
+    int64_t popped;
+
+    // longer than a delta holds: that sample comes early, the next one is
+    // on time again
+    const int64_t start = 500 * MS;
+    push(fifo, 1, start);
+    push(fifo, 2, start + 10000 * MS);
+    push(fifo, 3, start + 10010 * MS);
+    // going back in time reads as no time at all
+    push(fifo, 4, start + 10005 * MS);
+    EXPECT_EQ(fifo.size(), 4);
+
+    EXPECT_EQ(pop(fifo, &popped), 1);
+    EXPECT_EQ(popped, start);
+    EXPECT_EQ(pop(fifo, &popped), 2);
+    EXPECT_EQ(popped, start + MAX_DELTA_NS);
+    EXPECT_EQ(pop(fifo, &popped), 3);
+    EXPECT_EQ(popped, start + 10010 * MS);
+    EXPECT_EQ(pop(fifo, &popped), 4);
+    EXPECT_EQ(popped, start + 10010 * MS);
+    EXPECT(fifo.isEmpty());
+}
+
+static void testOverflow()
+{
+    AccelFifo<4> fifo;
+    int64_t popped;
+
+    // six into four: the first two make room, with the timestamps intact
+    const int64_t start = 2000 * MS;
+    for (int i=0 ; i<6 ; i++) {
+        push(fifo, i, start + i * 20 * MS);
+    }
+    EXPECT_EQ(fifo.size(), 4);
+    EXPECT_EQ(fifo.getOldestTimestamp(), start + 40 * MS);
+    for (int i=2 ; i<6 ; i++) {
+        EXPECT_EQ(pop(fifo, &popped), i);
+        EXPECT_EQ(popped, start + i * 20 * MS);
+    }
+    EXPECT(fifo.isEmpty());
+
+    // drained, the next sample starts over with its own timestamp
+    push(fifo, 7, start + 5000 * MS);
+    EXPECT_EQ(fifo.getOldestTimestamp(), start + 5000 * MS);
+    EXPECT_EQ(pop(fifo, &popped), 7);
+    EXPECT_EQ(popped, start + 5000 * MS);
+
+    // and so after a clear()
+    push(fifo, 8, start);
+    fifo.clear();
+    push(fifo, 9, start + 7000 * MS);
+    EXPECT_EQ(fifo.size(), 1);
+    EXPECT_EQ(pop(fifo, &popped), 9);
+    EXPECT_EQ(popped, start + 7000 * MS);
+}
+
+void testAccelFifo()
+{
+    testRounding();
+    testClamp();
+    testOverflow();
+}
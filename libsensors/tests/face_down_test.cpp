@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * FaceDown at the edges of its thresholds: ENTER_SAMPLES in a row flat
+ * and below DOWN_LSB enter, one sample short or one off does not, and
+ * once face down only LEAVE_SAMPLES in a row above UP_LSB leave. Between
+ * the two, the state holds.
+ */
+
+#include "FaceDown.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+// the state changes seen
+static int feed(FaceDown& faceDown, int count, int x, int y, int z)
+{
+    const int raw[3] = { x, y, z };
+    int changes = 0;
+    for (int i=0 ; i<count ; i++) {
+        if (faceDown.addSample(raw)) {
+            changes++;
+        }
+    }
+    return changes;
+}
+
+static void testEnter()
+{
+    FaceDown faceDown;
+    const int down = FaceDown::DOWN_LSB - 1;
+    const int flat = FaceDown::FLAT_LSB - 1;
+
+    // one short, then interrupted: the run starts over
+    EXPECT_EQ(feed(faceDown, FaceDown::ENTER_SAMPLES - 1, flat, -flat, down), 0);
+    EXPECT_EQ(feed(faceDown, 1, 0, 0, 256), 0);
+    EXPECT_EQ(feed(faceDown, FaceDown::ENTER_SAMPLES - 1, 0, 0, down), 0);
+    EXPECT(!faceDown.isFaceDown());
+    EXPECT_EQ(feed(faceDown, 1, 0, 0, down), 1);
+    EXPECT(faceDown.isFaceDown());
+
+    // reset() is face up
+    faceDown.reset();
+    EXPECT(!faceDown.isFaceDown());
+
+    // on the thresholds is not face down, nor tilted on either axis
+    EXPECT_EQ(feed(faceDown, 5 * FaceDown::ENTER_SAMPLES, 0, 0, FaceDown::DOWN_LSB), 0);
+    EXPECT_EQ(feed(faceDown, 5 * FaceDown::ENTER_SAMPLES, FaceDown::FLAT_LSB, 0, -256), 0);
+    EXPECT_EQ(feed(faceDown, 5 * FaceDown::ENTER_SAMPLES, 0, -FaceDown::FLAT_LSB, -256), 0);
+    EXPECT(!faceDown.isFaceDown());
+}
+
+static void testLeave()
+{
+    FaceDown faceDown;
+    EXPECT_EQ(feed(faceDown, FaceDown::ENTER_SAMPLES, 0, 0, -256), 1);
+
+    // between UP_LSB and DOWN_LSB, or tilted, it stays down
+    const int between = (FaceDown::UP_LSB + FaceDown::DOWN_LSB) / 2;
+    EXPECT_EQ(feed(faceDown, 5 * FaceDown::ENTER_SAMPLES, 0, 0, between), 0);
+    EXPECT_EQ(feed(faceDown, 5 * FaceDown::ENTER_SAMPLES, 150, -150, -256), 0);
+    EXPECT_EQ(feed(faceDown, 5 * FaceDown::ENTER_SAMPLES, 0, 0, FaceDown::UP_LSB - 1), 0);
+    EXPECT(faceDown.isFaceDown());
+
+    // a single sample up is a bump
+    EXPECT_EQ(feed(faceDown, FaceDown::LEAVE_SAMPLES - 1, 0, 0, FaceDown::UP_LSB), 0);
+    EXPECT_EQ(feed(faceDown, 1, 0, 0, -256), 0);
+    EXPECT(faceDown.isFaceDown());
+
+    // picked up, it leaves right away
+    EXPECT_EQ(feed(faceDown, FaceDown::LEAVE_SAMPLES, 0, 0, FaceDown::UP_LSB), 1);
+    EXPECT(!faceDown.isFaceDown());
+}
+
+void testFaceDown()
+{
+    testEnter();
+    testLeave();
+}
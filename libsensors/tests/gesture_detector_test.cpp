@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * GestureDetector on synthetic gestures at DELAY_MS: taps are a single
+ * sample spike on z, shakes a sine on x. Each gesture must be reported
+ * exactly once and as itself, taps only with the right gap and only once
+ * they settled, shakes only with enough strokes in the window, nothing
+ * during the cooldown, and an idle detector must wake up on a jerk.
+ */
+
+#include <math.h>
+
+#include "GestureDetector.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+#define REST_Z          256     // 1g
+#define TAP_Z           (GestureDetector::TAP_LSB + 20)
+#define MS              1000000LL
+
+namespace {
+
+// feeds samples DELAY_MS apart and collects what the detector reports
+struct Stream {
+    GestureDetector detector;
+    int64_t now;
+    int shakes;
+    int doubleTaps;
+
+    Stream() : now(1000 * MS), shakes(0), doubleTaps(0) {
+        rest(GestureDetector::DELAY_MS);
+    }
+
+    void sample(int x, int y, int z) {
+        const int raw[3] = { x, y, z };
+        const int found = detector.addSample(raw, now);
+        if (found & GestureDetector::SHAKE) {
+            shakes++;
+        }
+        if (found & GestureDetector::DOUBLE_TAP) {
+            doubleTaps++;
+        }
+        now += GestureDetector::DELAY_MS * MS;
+    }
+
+    void rest(int ms) {
+        for (int i=0 ; i<ms / GestureDetector::DELAY_MS ; i++) {
+            sample(0, 0, REST_Z);
+        }
+    }
+
+    // one sample spike, then at rest for ms after it
+    void tap(int ms, int z = TAP_Z) {
+        sample(0, 0, REST_Z + z);
+        rest(ms - GestureDetector::DELAY_MS);
+    }
+
+    // the second tap is reported once it settled
+    void doubleTap(int gap, int z = TAP_Z) {
+        tap(gap, z);
+        tap(GestureDetector::TAP_SETTLE_MS + GestureDetector::DELAY_MS, z);
+    }
+
+    void shake(int ms, double hz, int amplitude) {
+        for (int t=0 ; t<ms ; t+=GestureDetector::DELAY_MS) {
+            sample(int(lrint(amplitude * sin(2 * M_PI * hz * t / 1000))), 0, REST_Z);
+        }
+    }
+};
+
+}; // namespace
+
+static void testDoubleTap()
+{
+    Stream s;
+    s.rest(200);
+    s.doubleTap(250);
+    EXPECT_EQ(s.doubleTaps, 1);
+    EXPECT_EQ(s.shakes, 0);
+
+    // closer than TAP_MIN_GAP_MS is the first one bouncing, further than
+    // TAP_MAX_GAP_MS two single taps
+    Stream close;
+    close.tap(GestureDetector::TAP_MIN_GAP_MS - 2 * GestureDetector::DELAY_MS);
+    close.tap(400);
+    EXPECT_EQ(close.doubleTaps, 0);
+    Stream apart;
+    apart.tap(GestureDetector::TAP_MAX_GAP_MS + 100);
+    apart.tap(400);
+    EXPECT_EQ(apart.doubleTaps, 0);
+
+    // a bounce does not spoil the double tap it is part of
+    Stream bounce;
+    bounce.tap(GestureDetector::TAP_MIN_GAP_MS - 2 * GestureDetector::DELAY_MS);
+    bounce.tap(200);
+    bounce.tap(200);
+    EXPECT_EQ(bounce.doubleTaps, 1);
+
+    // under the threshold, no taps at all
+    Stream soft;
+    soft.tap(200, GestureDetector::TAP_LSB - 10);
+    soft.tap(400, GestureDetector::TAP_LSB - 10);
+    EXPECT_EQ(soft.doubleTaps, 0);
+}
+
+static void testHandling()
+{
+    // a tap, then still moving TAP_SETTLE_MS after the next peak: that
+    // one was no tap, and the first goes with it
+    Stream s;
+    s.tap(200);
+    for (int i=0 ; i<30 ; i++) {
+        s.sample(0, 0, REST_Z + (i & 1 ? TAP_Z : 0));
+    }
+    s.rest(GestureDetector::TAP_MAX_GAP_MS + 100);
+    EXPECT_EQ(s.doubleTaps, 0);
+}
+
+static void testShake()
+{
+    // a swing either way is a stroke: 2.5Hz is one every 200ms
+    static const double hz[] = { 2.0, 2.5, 3.0, 4.0 };
+    static const int amplitudes[] = { 300, 500, 700 };
+    for (size_t i=0 ; i<sizeof(hz)/sizeof(hz[0]) ; i++) {
+        for (size_t j=0 ; j<sizeof(amplitudes)/sizeof(amplitudes[0]) ; j++) {
+            Stream s;
+            s.shake(1000, hz[i], amplitudes[j]);
+            EXPECT_EQ(s.shakes, 1);
+            // however fast the swing turns, it is no double tap
+            EXPECT_EQ(s.doubleTaps, 0);
+        }
+    }
+
+    // under the threshold
+    Stream soft;
+    soft.shake(2000, 2.5, 250);
+    EXPECT_EQ(soft.shakes, 0);
+
+    // strokes too far apart for SHAKE_WINDOW_MS
+    Stream slow;
+    for (int i=0 ; i<2 * GestureDetector::SHAKE_STROKES ; i++) {
+        slow.sample(500, 0, REST_Z);
+        slow.rest(GestureDetector::SHAKE_WINDOW_MS / (GestureDetector::SHAKE_STROKES - 1) + 50);
+    }
+    EXPECT_EQ(slow.shakes, 0);
+}
+
+static void testCooldown()
+{
+    Stream s;
+    s.shake(1000, 2.5, 500);
+    EXPECT_EQ(s.shakes, 1);
+
+    // a double tap right after a shake is ignored, then counts again
+    s.doubleTap(200);
+    EXPECT_EQ(s.doubleTaps, 0);
+    s.rest(GestureDetector::COOLDOWN_MS);
+    s.doubleTap(200);
+    EXPECT_EQ(s.doubleTaps, 1);
+    EXPECT_EQ(s.shakes, 1);
+}
+
+static void testIdle()
+{
+    Stream s;
+    EXPECT(!s.detector.isIdle());
+    EXPECT_EQ(s.detector.getDelayMs(), GestureDetector::DELAY_MS);
+    s.rest(GestureDetector::IDLE_AFTER_MS + GestureDetector::DELAY_MS);
+    EXPECT(s.detector.isIdle());
+    EXPECT_EQ(s.detector.getDelayMs(), GestureDetector::IDLE_DELAY_MS);
+
+    // noise does not wake it, a tap does
+    s.sample(0, 0, REST_Z + GestureDetector::QUIET_LSB);
+    s.sample(0, 0, REST_Z);
+    EXPECT(s.detector.isIdle());
+    s.tap(GestureDetector::TAP_MAX_GAP_MS + 100);
+    EXPECT(!s.detector.isIdle());
+    EXPECT_EQ(s.detector.getDelayMs(), GestureDetector::DELAY_MS);
+    s.doubleTap(200);
+    EXPECT_EQ(s.doubleTaps, 1);
+}
+
+static void testSensitivity()
+{
+    // a hair trigger takes taps the default ignores
+    const int z = GestureDetector::TAP_LSB / 2;
+    Stream s;
+    s.detector.setSensitivity(9);
+    s.doubleTap(200, z);
+    EXPECT_EQ(s.doubleTaps, 1);
+
+    // out of range is the default
+    Stream d;
+    d.detector.setSensitivity(0);
+    d.doubleTap(200, z);
+    EXPECT_EQ(d.doubleTaps, 0);
+}
+
+void testGestureDetector()
+{
+    testDoubleTap();
+    testHandling();
+    testShake();
+    testCooldown();
+    testIdle();
+    testSensitivity();
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host microbenchmark of InputEventRing against the InputEventCircularReader
+ * it replaced. Both readers get the same bursts of accelerometer events
+ * through a non-blocking pipe, as from an evdev node, and are timed over
+ * one fill() plus decoding everything that is ready.
+ *
+ * Every burst size is run with the reader starting at the beginning of its
+ * buffer, then left near its end by the previous reads, first drained and
+ * then still holding a few events the driver had no room for. Read that
+ * way, a burst straddles the end of the buffer: the old reader copies the
+ * overflow back, the ring reads and hands out two runs unless it could
+ * start again at the beginning. Both readers must decode the same events.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <linux/input.h>
+
+#include "InputEventReader.h"
+#include "InputEventCircularReader.h"
+
+#define NUM_EVENTS      32      // what the drivers use
+#define ITERATIONS      20000
+#define WARMUP          1000
+#define HELD_EVENTS     3       // a partial frame
+
+static int sPipe[2];
+static int sSeq;
+
+static int64_t now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+// X, Y, Z and a SYN, over and over, like the bma250 driver reports
+static void feed(int numEvents)
+{
+    input_event events[NUM_EVENTS];
+    for (int i=0 ; i<numEvents ; i++, sSeq++) {
+        input_event& event = events[i];
+        memset(&event, 0, sizeof(event));
+        event.time.tv_usec = sSeq;
+        if (sSeq % 4 == 3) {
+            event.type = EV_SYN;
+        } else {
+            event.type = EV_ABS;
+            event.code = ABS_X + sSeq % 4;
+            event.value = sSeq;
+        }
+    }
+    if (write(sPipe[1], events, numEvents * sizeof(input_event))
+            != ssize_t(numEvents * sizeof(input_event))) {
+        perror("write");
+        exit(1);
+    }
+}
+
+static void decode(input_event const* event, int64_t* sum)
+{
+    if (event->type == EV_SYN) {
+        *sum += event->time.tv_usec;
+    } else {
+        *sum += event->code * event->value;
+    }
+}
+
+struct Ring {
+    InputEventRing<NUM_EVENTS> reader;
+
+    size_t read(int64_t* sum, size_t max = NUM_EVENTS) {
+        size_t numEvents = 0;
+        if (reader.fill(sPipe[0]) < 0)
+            return 0;
+        input_event const* events;
+        size_t ready;
+        while (numEvents < max && (ready = reader.span(&events))) {
+            if (ready > max - numEvents)
+                ready = max - numEvents;
+            for (size_t i=0 ; i<ready ; i++) {
+                decode(&events[i], sum);
+            }
+            reader.consume(ready);
+            numEvents += ready;
+        }
+        return numEvents;
+    }
+};
+
+struct Circular {
+    InputEventCircularReader reader;
+
+    Circular() : reader(NUM_EVENTS) { }
+
+    size_t read(int64_t* sum, size_t max = NUM_EVENTS) {
+        size_t numEvents = 0;
+        if (reader.fill(sPipe[0]) < 0)
+            return 0;
+        input_event const* event;
+        while (numEvents < max && reader.readEvent(&event)) {
+            decode(event, sum);
+            reader.next();
+            numEvents++;
+        }
+        return numEvents;
+    }
+};
+
+static int compare(void const* a, void const* b)
+{
+    int64_t x = *(int64_t const*)a, y = *(int64_t const*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Times ITERATIONS bursts, each read by a new reader whose earlier reads
+ * ended at start and left held events undecoded.
+ */
+template <typename Reader>
+static bool run(char const* name, int burst, int start, int held, int64_t* sum)
+{
+    static int64_t ns[ITERATIONS];
+
+    sSeq = 0;
+    for (int i=-WARMUP ; i<ITERATIONS ; i++) {
+        Reader reader;
+        int64_t ignored = 0;
+        if (start) {
+            feed(start);
+            reader.read(&ignored, start - held);
+        }
+        feed(burst);
+        int64_t t = now();
+        size_t numEvents = reader.read(sum);
+        t = now() - t;
+        if (numEvents != size_t(held + burst)) {
+            fprintf(stderr, "%s: read %zu events of a burst of %d at %d after %d\n",
+                    name, numEvents, burst, start, held);
+            return false;
+        }
+        if (i >= 0) {
+            ns[i] = t;
+        }
+    }
+
+    int64_t total = 0;
+    for (int i=0 ; i<ITERATIONS ; i++) {
+        total += ns[i];
+    }
+    qsort(ns, ITERATIONS, sizeof(ns[0]), compare);
+    printf("%-10s %5d %5d %4d %8.0f %8.0f %10.1f\n", name, burst, start, held,
+            double(ns[ITERATIONS / 2]), double(ns[ITERATIONS * 99 / 100]),
+            double(total) / ITERATIONS / (held + burst));
+    return true;
+}
+
+int main()
+{
+    static int const bursts[] = { 1, 4, 8, 16, 32 };
+    bool ok = true;
+
+    if (pipe(sPipe) || fcntl(sPipe[0], F_SETFL, O_NONBLOCK)) {
+        perror("pipe");
+        return 1;
+    }
+
+    printf("%-10s %5s %5s %4s %8s %8s %10s\n", "reader", "burst", "start", "held",
+            "p50 ns", "p99 ns", "ns/event");
+    for (size_t i=0 ; i<sizeof(bursts)/sizeof(bursts[0]) ; i++) {
+        int burst = bursts[i];
+        // aligned, then across the end of the buffer, drained and not
+        int starts[3] = { 0, NUM_EVENTS - burst/2, NUM_EVENTS - burst/2 };
+        int helds[3] = { 0, 0, HELD_EVENTS };
+        for (int j=0 ; j<3 ; j++) {
+            if (burst < 2 && j > 0)
+                break;
+            if (helds[j] + burst > NUM_EVENTS)
+                break;
+            int64_t ringSum = 0, circularSum = 0;
+            ok = run<Ring>("ring", burst, starts[j], helds[j], &ringSum) && ok;
+            ok = run<Circular>("circular", burst, starts[j], helds[j], &circularSum) && ok;
+            if (ringSum != circularSum) {
+                fprintf(stderr, "burst %d at %d after %d: the readers decoded different events\n",
+                        burst, starts[j], helds[j]);
+                ok = false;
+            }
+        }
+    }
+    return ok ? 0 : 1;
+}
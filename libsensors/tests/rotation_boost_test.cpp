@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * RotationBoost on synthetic rotations: a quadrant change held for
+ * CONFIRM_MS is a rotation and writes the boost file, a shorter one or a
+ * flat device is not, boosts are rate limited, rotations taken back are
+ * counted as reverted and, with the boost off, rotations are still
+ * counted. The counters are checked in what dumpStats() writes.
+ *
+ * The boost file is a plain file in a scratch tree under SENSORS_ROOT,
+ * truncated before each rotation so a boost shows as its two bytes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "RotationBoost.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+#define SAMPLE_MS       20      // the accelerometer at the UI rate
+#define MS              1000000LL
+#define CPUFREQ_DIR     SENSORS_ROOT "/sys/devices/system/cpu/cpu0/cpufreq"
+
+namespace {
+
+// what dumpStats() reports
+struct Stats {
+    unsigned rotations;
+    unsigned boosted;
+    unsigned notBoosted;
+    unsigned limited;
+    unsigned off;
+    unsigned reverted;
+    long long boostedLeadMs;
+    long long boostedMaxMs;
+    unsigned boostedSettled;
+    long long otherLeadMs;
+    long long otherMaxMs;
+    unsigned otherSettled;
+
+    Stats() { memset(this, 0, sizeof(*this)); }
+
+    bool read() {
+        FILE* file = tmpfile();
+        if (!file)
+            return false;
+        RotationBoost::dumpStats(file);
+        rewind(file);
+        // nothing at all before the first rotation
+        int fields = fscanf(file, "# rotations %u, boosted %u, not boosted %u "
+                "(rate limited %u, boost off %u), reverted %u\n",
+                &rotations, &boosted, &notBoosted, &limited, &off, &reverted);
+        if (fields == 6) {
+            fields += fscanf(file, "# boosted rotations at rest %lldms after the "
+                    "prediction on average, %lldms at most, over %u\n",
+                    &boostedLeadMs, &boostedMaxMs, &boostedSettled);
+            fields += fscanf(file, "# other rotations at rest %lldms after the "
+                    "prediction on average, %lldms at most, over %u\n",
+                    &otherLeadMs, &otherMaxMs, &otherSettled);
+        }
+        fclose(file);
+        return fields == EOF || fields == 12;
+    }
+};
+
+// feeds samples SAMPLE_MS apart
+struct Device {
+    RotationBoost boost;
+    int64_t now;
+
+    Device() : now(1000 * MS) { }
+
+    void hold(int x, int y, int z, int ms) {
+        const int raw[3] = { x, y, z };
+        for (int t=0 ; t<ms ; t+=SAMPLE_MS) {
+            boost.addSample(raw, now);
+            now += SAMPLE_MS * MS;
+        }
+    }
+
+    // upright, then counter-clockwise, as the events report it
+    void hold(int quadrant, int ms) {
+        static const int xy[4][2] = { { 256, 0 }, { 0, -256 }, { -256, 0 }, { 0, 256 } };
+        hold(xy[quadrant][0], xy[quadrant][1], 40, ms);
+    }
+};
+
+}; // namespace
+
+static void makeTree()
+{
+    static const char* const dirs[] = {
+        SENSORS_ROOT, SENSORS_ROOT "/sys", SENSORS_ROOT "/sys/devices",
+        SENSORS_ROOT "/sys/devices/system", SENSORS_ROOT "/sys/devices/system/cpu",
+        SENSORS_ROOT "/sys/devices/system/cpu/cpu0", CPUFREQ_DIR,
+    };
+    if (system("rm -rf " SENSORS_ROOT)) {
+        exit(1);
+    }
+    for (size_t i=0 ; i<sizeof(dirs)/sizeof(*dirs) ; i++) {
+        mkdir(dirs[i], 0755);
+    }
+}
+
+// whether the boost file was written since the last call
+static bool boosted()
+{
+    struct stat st;
+    if (stat(BOOST_CPUFREQ_FILE, &st))
+        return false;
+    if (truncate(BOOST_CPUFREQ_FILE, 0))
+        return false;
+    return st.st_size == 2;
+}
+
+static void testNoBoostFile()
+{
+    Stats before, after;
+    EXPECT(before.read());
+
+    // enabled without a boost file: counted, but neither boosted nor
+    // limited, and not retried
+    Device d;
+    d.boost.setEnabled(true);
+    d.hold(0, 200);
+    d.hold(1, 200);
+    d.hold(0, 200);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 2);
+    EXPECT_EQ(after.boosted - before.boosted, 0);
+    EXPECT_EQ(after.limited - before.limited, 0);
+    EXPECT_EQ(after.off - before.off, 0);
+}
+
+static void testRotations()
+{
+    int fd = open(BOOST_CPUFREQ_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    EXPECT(fd >= 0);
+    close(fd);
+
+    Stats before, after;
+    EXPECT(before.read());
+    Device d;
+    d.boost.setEnabled(true);
+
+    // the first reading is no rotation, nor is a device lying flat, held
+    // on the diagonal or turning for less than CONFIRM_MS
+    d.hold(0, 500);
+    d.hold(0, 0, 256, 500);
+    d.hold(200, -200, 40, 500);
+    d.hold(1, RotationBoost::CONFIRM_MS - SAMPLE_MS);
+    d.hold(0, 500);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 0);
+    EXPECT(!boosted());
+
+    // a rotation boosts, the device comes to rest soon after
+    d.hold(1, 500);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 1);
+    EXPECT_EQ(after.boosted - before.boosted, 1);
+    EXPECT_EQ(after.boostedSettled - before.boostedSettled, 1);
+    EXPECT(after.boostedMaxMs <= RotationBoost::CONFIRM_MS);
+    EXPECT(boosted());
+
+    // turning back within REVERT_MS takes it back, too soon for a boost
+    d.hold(0, RotationBoost::REVERT_MS - 500);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 2);
+    EXPECT_EQ(after.reverted - before.reverted, 1);
+    EXPECT_EQ(after.limited - before.limited, 1);
+    EXPECT_EQ(after.otherSettled - before.otherSettled, 1);
+    EXPECT(!boosted());
+
+    // MIN_INTERVAL_MS on, it boosts again
+    d.hold(0, RotationBoost::MIN_INTERVAL_MS);
+    d.hold(3, 500);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 3);
+    EXPECT_EQ(after.boosted - before.boosted, 2);
+    EXPECT_EQ(after.reverted - before.reverted, 1);
+    EXPECT(boosted());
+
+    // with the boost off rotations are only counted
+    d.boost.setEnabled(false);
+    d.hold(2, RotationBoost::MIN_INTERVAL_MS);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 4);
+    EXPECT_EQ(after.boosted - before.boosted, 2);
+    EXPECT_EQ(after.off - before.off, 1);
+    EXPECT_EQ(after.notBoosted - before.notBoosted, 2);
+    EXPECT(!boosted());
+
+    // reset() forgets the orientation, the next reading is the first
+    d.boost.setEnabled(true);
+    d.boost.reset();
+    d.hold(1, 500);
+    EXPECT(after.read());
+    EXPECT_EQ(after.rotations - before.rotations, 4);
+    EXPECT(!boosted());
+}
+
+void testRotationBoost()
+{
+    makeTree();
+    testNoBoostFile();
+    testRotations();
+}
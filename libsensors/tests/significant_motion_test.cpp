@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * SignificantMotion around its thresholds: motion beyond MOTION_LSB in
+ * MOTION_SAMPLES of the last 32 samples triggers, on exactly the sample
+ * that completes the count. Rest, small vibration, a tilt and motion
+ * that stops half the time do not.
+ */
+
+#include "SignificantMotion.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+#define REST_Z          256     // 1g
+#define HISTORY         32
+
+// the first sample to trigger, -1 for none
+static int feed(SignificantMotion& motion, int count, int amplitude, int period)
+{
+    for (int i=0 ; i<count ; i++) {
+        // a square wave on x, still for the second half of each period
+        int x = 0;
+        if (amplitude && (i % period) < (period + 1) / 2) {
+            x = i & 1 ? amplitude : -amplitude;
+        }
+        const int raw[3] = { x, 0, REST_Z };
+        if (motion.addSample(raw))
+            return i;
+    }
+    return -1;
+}
+
+static void testMoving()
+{
+    SignificantMotion motion;
+    const int rest[3] = { 0, 0, REST_Z };
+
+    // picked up from rest, the first sample only seeds the baseline
+    EXPECT(!motion.addSample(rest));
+    EXPECT_EQ(feed(motion, 100, 2 * SignificantMotion::MOTION_LSB, 1),
+            SignificantMotion::MOTION_SAMPLES - 1);
+
+    // reset() forgets the history
+    motion.reset();
+    EXPECT(!motion.addSample(rest));
+    EXPECT_EQ(feed(motion, SignificantMotion::MOTION_SAMPLES - 1,
+            2 * SignificantMotion::MOTION_LSB, 1), -1);
+    EXPECT_EQ(feed(motion, 1, 2 * SignificantMotion::MOTION_LSB, 1), 0);
+}
+
+static void testStill()
+{
+    SignificantMotion motion;
+    EXPECT_EQ(feed(motion, 10 * HISTORY, 0, 1), -1);
+
+    // vibration under the threshold
+    motion.reset();
+    EXPECT_EQ(feed(motion, 10 * HISTORY, SignificantMotion::MOTION_LSB / 3, 1), -1);
+
+    // moving only half the time
+    motion.reset();
+    EXPECT_EQ(feed(motion, 10 * HISTORY, 2 * SignificantMotion::MOTION_LSB, HISTORY), -1);
+}
+
+static void testTilt()
+{
+    SignificantMotion motion;
+    const int flat[3] = { 0, 0, REST_Z };
+    const int tilted[3] = { 200, 0, REST_Z - 80 };
+
+    // picked up and put down at an angle: the baseline catches up before
+    // enough samples have moved
+    EXPECT(!motion.addSample(flat));
+    for (int i=0 ; i<4 * HISTORY ; i++) {
+        EXPECT(!motion.addSample(tilted));
+    }
+}
+
+void testSignificantMotion()
+{
+    testMoving();
+    testStill();
+    testTilt();
+}
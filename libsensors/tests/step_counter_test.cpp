@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * StepCounter on a synthetic walk: a 2Hz vertical bounce sampled at the
+ * counter's own rate counts one step per bounce, once the filters have
+ * settled. Rest and a bounce too small to clear STEP_HIGH count nothing,
+ * and bounces closer together than MIN_STEP_MS are not all steps.
+ */
+
+#include <math.h>
+
+#include "StepCounter.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+#define REST_Z          256     // 1g
+#define RATE_HZ         (1000 / StepCounter::DELAY_MS)
+#define WALK_HZ         2
+#define WALK_LSB        77      // ~0.3g
+#define MS              1000000LL
+
+/*
+ * Feeds seconds of a bounce on z, with samples timestamped period ns
+ * apart, and returns the steps counted.
+ */
+static int walk(StepCounter& counter, int seconds, int amplitude, int64_t period)
+{
+    const uint64_t before = counter.getSteps();
+    int returned = 0;
+    for (int i=0 ; i<seconds * RATE_HZ ; i++) {
+        const double phase = 2 * M_PI * WALK_HZ * i / RATE_HZ;
+        const int raw[3] = { 3, -5, REST_Z + int(lrint(amplitude * sin(phase))) };
+        if (counter.addSample(raw, 1000 * MS + i * period)) {
+            returned++;
+        }
+    }
+    // what addSample() returned adds up to the count
+    EXPECT_EQ(int64_t(counter.getSteps() - before), returned);
+    return returned;
+}
+
+static void testWalking()
+{
+    StepCounter counter;
+
+    // ten seconds at 2Hz, the first bounce may go to the filters
+    const int steps = walk(counter, 10, WALK_LSB, StepCounter::DELAY_MS * MS);
+    EXPECT(steps >= 10 * WALK_HZ - 1);
+    EXPECT(steps <= 10 * WALK_HZ);
+
+    // reset() clears the filters, not the count
+    counter.reset();
+    EXPECT_EQ(int64_t(counter.getSteps()), steps);
+    EXPECT(walk(counter, 5, WALK_LSB, StepCounter::DELAY_MS * MS) >= 5 * WALK_HZ - 1);
+}
+
+static void testStill()
+{
+    StepCounter counter;
+    EXPECT_EQ(walk(counter, 10, 0, StepCounter::DELAY_MS * MS), 0);
+
+    // about 2 * 10 LSB on the magnitude, under STEP_HIGH
+    EXPECT_EQ(walk(counter, 10, 10, StepCounter::DELAY_MS * MS), 0);
+}
+
+static void testMinInterval()
+{
+    StepCounter counter;
+
+    // the same samples four times as close together: bounces every
+    // 125ms, of which at most one per MIN_STEP_MS counts
+    const int64_t period = StepCounter::DELAY_MS * MS / 4;
+    const int steps = walk(counter, 10, WALK_LSB, period);
+    const int64_t span = 10 * RATE_HZ * period;
+    EXPECT(steps <= span / (StepCounter::MIN_STEP_MS * MS) + 1);
+    EXPECT(steps >= 10 * WALK_HZ / 2 - 1);
+}
+
+void testStepCounter()
+{
+    testWalking();
+    testStill();
+    testMinInterval();
+}
@@ -0,0 +1,576 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test of the control path, meant to be run under ThreadSanitizer:
+ * a few threads hammer activate(), setDelay() and batch() while the poll
+ * thread reads a stand-in accelerometer. Afterwards the sysfs nodes must
+ * agree with the last requests, and activate() must report a driver that
+ * cannot be enabled, right away or on the next call.
+ *
+ * Before that, the first enable measures the accelerometer rates, and
+ * its client must not see them. After, the stats come out on request,
+ * and the accelerometer pauses while the screen is off.
+ *
+ * The HAL is built with SENSORS_ROOT pointing at a scratch tree, where
+ * sysfs nodes are plain files and input devices are FIFOs. Built with
+ * SENSORS_TRACE as well, the trace points must have written well formed,
+ * balanced records to the host trace file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+
+#include <cutils/atomic.h>
+#include <hardware/sensors.h>
+
+#include "nusensors.h"
+#include "BMA250.h"
+#include "SensorStats.h"
+
+#define STORM_THREADS       4
+#define STORM_REQUESTS      2000
+#define PROBE_CLIENT_MS     100
+#define PROBE_TIMEOUT_S     20
+#define MAX_RECORDED        1024
+#define APPLY_WAIT_MS       500
+
+#define ACCEL_DIR   SENSORS_ROOT "/sys/bus/i2c/devices/4-0018"
+#define LIGHT_DIR   SENSORS_ROOT "/sys/bus/i2c/devices/4-0010"
+#define POWER_DIR   SENSORS_ROOT "/sys/power"
+#define TRACE_FILE  SENSORS_ROOT "/trace"
+#define MAX_TRACED_THREADS  16
+
+extern "C" struct sensors_module_t HAL_MODULE_INFO_SYM;
+
+// nothing to keep awake or light up on the host
+extern "C" int acquire_wake_lock(int, const char*) { return 0; }
+extern "C" int release_wake_lock(const char*) { return 0; }
+extern "C" int hw_get_module(const char*, const struct hw_module_t**) { return -ENOENT; }
+
+static sensors_poll_device_1_t* sDevice;
+static struct sensor_t const* sList;
+static int sCount;
+static volatile int32_t sStop;
+static volatile int32_t sFeedStop;
+static int sAccelFd = -1;
+static int sSleepFd = -1;
+static int sWakeFd = -1;
+static volatile int32_t sFailures;
+
+// accelerometer timestamps seen by the poll thread
+static pthread_mutex_t sRecordLock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t sRecorded[MAX_RECORDED];
+static int sRecordedCount;
+
+static void fail(const char* what, int handle, int err)
+{
+    fprintf(stderr, "FAIL: %s, handle %d (%s)\n", what, handle, strerror(-err));
+    android_atomic_inc(&sFailures);
+}
+
+static void writeNode(const char* path, const char* value)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, value, strlen(value)) < 0) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
+
+static int readNode(const char* path)
+{
+    char buf[16];
+    int fd = open(path, O_RDONLY);
+    int n = fd < 0 ? -1 : read(fd, buf, sizeof(buf) - 1);
+    if (fd >= 0)
+        close(fd);
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    return atoi(buf);
+}
+
+static void makeTree()
+{
+    static const char* const dirs[] = {
+        SENSORS_ROOT, SENSORS_ROOT "/sys", SENSORS_ROOT "/sys/bus",
+        SENSORS_ROOT "/sys/bus/i2c", SENSORS_ROOT "/sys/bus/i2c/devices",
+        ACCEL_DIR, LIGHT_DIR, SENSORS_ROOT "/data", SENSORS_ROOT "/data/system",
+        SENSOR_STATS_DIR,
+        SENSORS_ROOT "/dev", SENSORS_ROOT "/dev/input", POWER_DIR,
+    };
+    if (system("rm -rf " SENSORS_ROOT)) {
+        exit(1);
+    }
+    for (size_t i=0 ; i<sizeof(dirs)/sizeof(*dirs) ; i++) {
+        mkdir(dirs[i], 0755);
+    }
+    writeNode(ACCEL_DIR "/enable", "0\n");
+    writeNode(ACCEL_DIR "/delay", "200\n");
+    writeNode(LIGHT_DIR "/enable", "0\n");
+    writeNode(LIGHT_DIR "/delay", "200\n");
+    mkfifo(SENSORS_ROOT "/dev/input/bma250", 0644);
+    mkfifo(SENSORS_ROOT "/dev/input/lightsensor-level", 0644);
+
+    // keep a writer on each FIFO so the readers never see a hangup
+    sAccelFd = open(SENSORS_ROOT "/dev/input/bma250", O_RDWR | O_NONBLOCK);
+    int lightFd = open(SENSORS_ROOT "/dev/input/lightsensor-level", O_RDWR | O_NONBLOCK);
+    if (sAccelFd < 0 || lightFd < 0) {
+        perror("fifo");
+        exit(1);
+    }
+
+    // early suspend: a byte in either FIFO is a screen transition
+    mkfifo(POWER_DIR "/wait_for_fb_sleep", 0644);
+    mkfifo(POWER_DIR "/wait_for_fb_wake", 0644);
+    sSleepFd = open(POWER_DIR "/wait_for_fb_sleep", O_RDWR | O_NONBLOCK);
+    sWakeFd = open(POWER_DIR "/wait_for_fb_wake", O_RDWR | O_NONBLOCK);
+    if (sSleepFd < 0 || sWakeFd < 0) {
+        perror("fifo");
+        exit(1);
+    }
+}
+
+static void* pollThread(void*)
+{
+    sensors_event_t buffer[16];
+    while (!android_atomic_acquire_load(&sStop)) {
+        int n = sDevice->poll(&sDevice->v0, buffer, 16);
+        if (n < 0) {
+            fail("poll", -1, n);
+            break;
+        }
+        pthread_mutex_lock(&sRecordLock);
+        for (int i=0 ; i<n && sRecordedCount<MAX_RECORDED ; i++) {
+            if (buffer[i].sensor == ID_A) {
+                sRecorded[sRecordedCount++] = buffer[i].timestamp;
+            }
+        }
+        pthread_mutex_unlock(&sRecordLock);
+    }
+    return NULL;
+}
+
+// one accelerometer report per programmed delay, as the driver would send
+static void* feedThread(void*)
+{
+    struct input_event frame[4];
+    memset(frame, 0, sizeof(frame));
+    frame[0].type = EV_ABS;  frame[0].code = ABS_X;  frame[0].value = 10;
+    frame[1].type = EV_ABS;  frame[1].code = ABS_Y;  frame[1].value = 20;
+    frame[2].type = EV_ABS;  frame[2].code = ABS_Z;  frame[2].value = 250;
+    frame[3].type = EV_SYN;  frame[3].code = SYN_REPORT;
+    while (!android_atomic_acquire_load(&sFeedStop)) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (int i=0 ; i<4 ; i++) {
+            frame[i].time.tv_sec = now.tv_sec;
+            frame[i].time.tv_usec = now.tv_nsec / 1000;
+        }
+        // a full FIFO just drops the frame, the reader is behind
+        if (write(sAccelFd, frame, sizeof(frame)) < 0 && errno != EAGAIN) {
+            perror("feed");
+            break;
+        }
+        int delayMs = readNode(ACCEL_DIR "/delay");
+        usleep((delayMs > 0 ? delayMs : 1) * 1000);
+    }
+    return NULL;
+}
+
+static void* stormThread(void* arg)
+{
+    unsigned int seed = (unsigned int)(long)arg;
+    struct sensor_t const* list;
+    int count = HAL_MODULE_INFO_SYM.get_sensors_list(&HAL_MODULE_INFO_SYM, &list);
+    if (count != sCount || list != sList) {
+        fail("get_sensors_list", -1, 0);
+        return NULL;
+    }
+    for (int i=0 ; i<STORM_REQUESTS ; i++) {
+        struct sensor_t const* sensor = &list[rand_r(&seed) % count];
+        int64_t period = int64_t(5 + rand_r(&seed) % 200) * 1000000LL;
+        int err;
+        switch (rand_r(&seed) % 3) {
+            case 0:
+                err = sDevice->activate(&sDevice->v0, sensor->handle, rand_r(&seed) & 1);
+                if (err)
+                    fail("activate", sensor->handle, err);
+                break;
+            case 1:
+                err = sDevice->setDelay(&sDevice->v0, sensor->handle, period);
+                if (err)
+                    fail("setDelay", sensor->handle, err);
+                break;
+            case 2:
+                err = sDevice->batch(sDevice, sensor->handle, 0, period,
+                        sensor->type == SENSOR_TYPE_ACCELEROMETER ? period * 4 : 0);
+                if (err)
+                    fail("batch", sensor->handle, err);
+                break;
+        }
+    }
+    return NULL;
+}
+
+// activate() doesn't wait for the poll thread, give it APPLY_WAIT_MS
+static void expectNode(const char* path, int value)
+{
+    int actual = readNode(path);
+    for (int i=0 ; i<APPLY_WAIT_MS / 10 && actual != value ; i++) {
+        usleep(10000);
+        actual = readNode(path);
+    }
+    if (actual != value) {
+        fprintf(stderr, "FAIL: %s is %d, expected %d\n", path, actual, value);
+        android_atomic_inc(&sFailures);
+    }
+}
+
+static void enableAll(int enabled)
+{
+    for (int i=0 ; i<sCount ; i++) {
+        int err = sDevice->activate(&sDevice->v0, sList[i].handle, enabled);
+        if (err)
+            fail(enabled ? "enable" : "disable", sList[i].handle, err);
+    }
+}
+
+static void expectFailure(const char* node, int handle)
+{
+    unlink(node);
+    mkdir(node, 0755);
+    int err = sDevice->activate(&sDevice->v0, handle, 1);
+    if (!err)
+        fail("activate with no enable node succeeded", handle, 0);
+    rmdir(node);
+    writeNode(node, "0\n");
+    err = sDevice->activate(&sDevice->v0, handle, 1);
+    if (err)
+        fail("activate once the node is back", handle, err);
+    expectNode(node, 1);
+}
+
+/*
+ * An enable node that opens but refuses the write only fails on the poll
+ * thread, which the next activate() of the handle reports.
+ */
+static void expectLateFailure(const char* node, int handle)
+{
+    unlink(node);
+    if (symlink("/dev/full", node)) {
+        fail("no /dev/full", handle, -errno);
+        return;
+    }
+    int err = sDevice->activate(&sDevice->v0, handle, 1);
+    if (err)
+        fail("enable with a node that opens", handle, err);
+    usleep(APPLY_WAIT_MS * 1000);
+    err = sDevice->activate(&sDevice->v0, handle, 0);
+    if (err != -ENOSPC)
+        fail("the disable after a refused enable", handle, err);
+    err = sDevice->activate(&sDevice->v0, handle, 0);
+    if (err)
+        fail("a failure reported twice", handle, err);
+    unlink(node);
+    writeNode(node, "0\n");
+}
+
+/*
+ * The first enable steps the part through its delays, from 5ms up. A
+ * client asking for PROBE_CLIENT_MS meanwhile must not get faster than
+ * that, give or take the 1/8 the probe allows.
+ */
+static void checkProbe()
+{
+    sDevice->setDelay(&sDevice->v0, ID_A, PROBE_CLIENT_MS * 1000000LL);
+    int err = sDevice->activate(&sDevice->v0, ID_A, 1);
+    if (err)
+        fail("enable for the probe", ID_A, err);
+    for (int i=0 ; i<PROBE_TIMEOUT_S * 10 && access(BMA250_RATES_FILE, F_OK) ; i++) {
+        usleep(100000);
+    }
+    if (access(BMA250_RATES_FILE, F_OK))
+        fail("no rates measured", ID_A, -errno);
+    sDevice->activate(&sDevice->v0, ID_A, 0);
+
+    pthread_mutex_lock(&sRecordLock);
+    int64_t shortest = -1;
+    for (int i=1 ; i<sRecordedCount ; i++) {
+        int64_t interval = sRecorded[i] - sRecorded[i - 1];
+        if (shortest < 0 || interval < shortest)
+            shortest = interval;
+    }
+    if (sRecordedCount < 2 || shortest < PROBE_CLIENT_MS * 1000000LL * 7 / 8) {
+        fprintf(stderr, "FAIL: %d events during the probe, %lldus apart at least\n",
+                sRecordedCount, (long long)(shortest / 1000));
+        android_atomic_inc(&sFailures);
+    }
+    sRecordedCount = MAX_RECORDED;
+    pthread_mutex_unlock(&sRecordLock);
+}
+
+// touching the request file has the poll thread write its stats out,
+// neither a sensor going off nor other files in the directory do
+static void checkStatsRequest()
+{
+    char path[PATH_MAX];
+    char comm[16] = "";
+    FILE* file = fopen("/proc/self/comm", "r");
+    if (file) {
+        fscanf(file, "%15s", comm);
+        fclose(file);
+    }
+    snprintf(path, sizeof(path), SENSOR_STATS_FILE, comm);
+    unlink(path);
+    sDevice->activate(&sDevice->v0, ID_A, 1);
+    sDevice->activate(&sDevice->v0, ID_A, 0);
+    expectNode(ACCEL_DIR "/enable", 0);
+    writeNode(SENSOR_STATS_DIR "/other", "");
+    unlink(SENSOR_STATS_DIR "/other");
+    usleep(200000);
+    if (!access(path, F_OK)) {
+        fprintf(stderr, "FAIL: %s written without a request\n", path);
+        android_atomic_inc(&sFailures);
+    }
+
+    // touch(1) only changes the times, writing it closes it after writing
+    for (int i=0 ; i<2 ; i++) {
+        unlink(path);
+        if (i) {
+            writeNode(SENSOR_STATS_REQUEST, "");
+        } else if (utimensat(AT_FDCWD, SENSOR_STATS_REQUEST, NULL, 0)) {
+            perror(SENSOR_STATS_REQUEST);
+            exit(1);
+        }
+        for (int j=0 ; j<50 && access(path, F_OK) ; j++) {
+            usleep(20000);
+        }
+        if (access(path, F_OK)) {
+            fprintf(stderr, "FAIL: no %s on request\n", path);
+            android_atomic_inc(&sFailures);
+        }
+    }
+}
+
+static int countThreads()
+{
+    char line[64];
+    int threads = -1;
+    FILE* file = fopen("/proc/self/status", "r");
+    while (file && fgets(line, sizeof(line), file)) {
+        sscanf(line, "Threads: %d", &threads);
+    }
+    if (file)
+        fclose(file);
+    return threads;
+}
+
+/*
+ * The accelerometer pauses while the screen is off, in every context,
+ * including one opened meanwhile. Opening and closing contexts costs no
+ * thread.
+ */
+static void checkSuspend()
+{
+    int err = sDevice->activate(&sDevice->v0, ID_A, 1);
+    if (err)
+        fail("enable before suspend", ID_A, err);
+    expectNode(ACCEL_DIR "/enable", 1);
+
+    write(sSleepFd, "s", 1);
+    expectNode(ACCEL_DIR "/enable", 0);
+    const int threads = countThreads();
+    for (int i=0 ; i<8 ; i++) {
+        sensors_poll_device_1_t* device;
+        err = HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+                SENSORS_HARDWARE_POLL_SECONDARY, reinterpret_cast<hw_device_t**>(&device));
+        if (err) {
+            fail("open another context", -1, err);
+            break;
+        }
+        device->common.close(&device->common);
+    }
+    if (countThreads() != threads) {
+        fprintf(stderr, "FAIL: %d threads after opening contexts, %d before\n",
+                countThreads(), threads);
+        android_atomic_inc(&sFailures);
+    }
+
+    write(sWakeFd, "w", 1);
+    expectNode(ACCEL_DIR "/enable", 1);
+    sDevice->activate(&sDevice->v0, ID_A, 0);
+    expectNode(ACCEL_DIR "/enable", 0);
+}
+
+#ifdef SENSORS_TRACE
+/*
+ * Every line is one ftrace trace_marker record from this process, each
+ * thread's clock never goes back, and every B has its E.
+ */
+static void checkTrace()
+{
+    FILE* file = fopen(TRACE_FILE, "r");
+    if (!file) {
+        fail("no trace file", -1, -errno);
+        return;
+    }
+    int tids[MAX_TRACED_THREADS], depth[MAX_TRACED_THREADS];
+    int64_t last[MAX_TRACED_THREADS];
+    int numThreads = 0, numLines = 0;
+    bool sawPoll = false, sawFill = false;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        int tid, offset = -1;
+        long sec, usec;
+        numLines++;
+        sscanf(line, "sensors-%d [000] ...1 %ld.%ld: tracing_mark_write: %n",
+                &tid, &sec, &usec, &offset);
+        if (offset < 0) {
+            fprintf(stderr, "FAIL: trace line %d: %s", numLines, line);
+            android_atomic_inc(&sFailures);
+            continue;
+        }
+        int t = 0;
+        while (t < numThreads && tids[t] != tid)
+            t++;
+        if (t == numThreads) {
+            if (numThreads == MAX_TRACED_THREADS) {
+                fail("too many traced threads", -1, -E2BIG);
+                break;
+            }
+            tids[t] = tid;
+            depth[t] = 0;
+            last[t] = 0;
+            numThreads++;
+        }
+        const int64_t time = sec*1000000LL + usec;
+        if (time < last[t]) {
+            fprintf(stderr, "FAIL: trace line %d goes back in time\n", numLines);
+            android_atomic_inc(&sFailures);
+        }
+        last[t] = time;
+
+        const char* record = line + offset;
+        int pid = -1, value;
+        char name[64];
+        if (record[0] == 'E') {
+            if (--depth[t] < 0) {
+                fprintf(stderr, "FAIL: trace line %d ends nothing\n", numLines);
+                android_atomic_inc(&sFailures);
+                depth[t] = 0;
+            }
+        } else if (sscanf(record, "B|%d|%63[^\n]", &pid, name) == 2) {
+            depth[t]++;
+            sawPoll |= !strcmp(name, "pollEvents");
+        } else if (sscanf(record, "C|%d|%63[^|]|%d", &pid, name, &value) == 3) {
+            sawFill |= !strcmp(name, "bma250 fill");
+        } else {
+            fprintf(stderr, "FAIL: trace line %d: %s", numLines, line);
+            android_atomic_inc(&sFailures);
+        }
+        if (record[0] != 'E' && pid != getpid()) {
+            fprintf(stderr, "FAIL: trace line %d is from pid %d\n", numLines, pid);
+            android_atomic_inc(&sFailures);
+        }
+    }
+    fclose(file);
+
+    for (int t=0 ; t<numThreads ; t++) {
+        if (depth[t]) {
+            fprintf(stderr, "FAIL: thread %d left %d sections open\n", tids[t], depth[t]);
+            android_atomic_inc(&sFailures);
+        }
+    }
+    if (!sawPoll || !sawFill) {
+        fail("no pollEvents section or bma250 fill counter in the trace", -1, -ENOENT);
+    }
+}
+#endif
+
+int main()
+{
+    makeTree();
+#ifdef SENSORS_TRACE
+    setenv("SENSORS_TRACE_FILE", TRACE_FILE, 1);
+#endif
+    sCount = HAL_MODULE_INFO_SYM.get_sensors_list(&HAL_MODULE_INFO_SYM, &sList);
+    int err = HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+            SENSORS_HARDWARE_POLL, reinterpret_cast<hw_device_t**>(&sDevice));
+    if (err) {
+        fprintf(stderr, "open failed (%s)\n", strerror(-err));
+        return 1;
+    }
+
+    pthread_t poller, feeder, storm[STORM_THREADS];
+    pthread_create(&poller, NULL, pollThread, NULL);
+    pthread_create(&feeder, NULL, feedThread, NULL);
+    checkProbe();
+    for (long i=0 ; i<STORM_THREADS ; i++) {
+        pthread_create(&storm[i], NULL, stormThread, (void*)(i + 1));
+    }
+    for (int i=0 ; i<STORM_THREADS ; i++) {
+        pthread_join(storm[i], NULL);
+    }
+
+    // once the storm is over, the nodes follow the requests
+    enableAll(0);
+    expectNode(ACCEL_DIR "/enable", 0);
+    expectNode(LIGHT_DIR "/enable", 0);
+    enableAll(1);
+    expectNode(ACCEL_DIR "/enable", 1);
+    expectNode(LIGHT_DIR "/enable", 1);
+    enableAll(0);
+    expectNode(ACCEL_DIR "/enable", 0);
+    expectNode(LIGHT_DIR "/enable", 0);
+
+    // a node that cannot be written fails the activate() that needed it
+    expectFailure(ACCEL_DIR "/enable", ID_A);
+    expectFailure(LIGHT_DIR "/enable", ID_B);
+    sDevice->activate(&sDevice->v0, ID_B, 0);
+    sDevice->activate(&sDevice->v0, ID_A, 0);
+    expectNode(ACCEL_DIR "/enable", 0);
+    expectLateFailure(ACCEL_DIR "/enable", ID_A);
+
+    checkStatsRequest();
+    checkSuspend();
+
+    // the poll thread only comes back with events, keep them coming
+    android_atomic_release_store(1, &sStop);
+    sDevice->activate(&sDevice->v0, ID_A, 1);
+    pthread_join(poller, NULL);
+    android_atomic_release_store(1, &sFeedStop);
+    pthread_join(feeder, NULL);
+    sDevice->common.close(&sDevice->common);
+#ifdef SENSORS_TRACE
+    checkTrace();
+#endif
+
+    printf("%s: %d threads x %d requests, %d failures\n",
+            sFailures ? "FAILED" : "PASSED", STORM_THREADS, STORM_REQUESTS, sFailures);
+    return sFailures ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * TimerWheel against the real timerfd. The poll thread is played by
+ * poll() on getFd(): every timer must fire on time and not before, the
+ * timerfd must follow the earliest timer as timers move and go, and
+ * timers sharing a slot or left behind by a late wakeup must expire in
+ * the right turn.
+ */
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "SensorBase.h"
+#include "TimerWheel.h"
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+#define SLACK_NS        5000000LL               // 5ms ticks
+#define TURN_NS         (TimerWheel::NUM_SLOTS * SLACK_NS)
+#define MS              1000000LL
+
+namespace {
+
+struct Fired {
+    int count;
+    int64_t at;
+    TimerWheel* wheel;
+    SensorTimer* timer;
+    int64_t period;             // rescheduled that much later while > 0
+    int again;
+
+    Fired() : count(0), at(0), wheel(NULL), timer(NULL), period(0), again(0) { }
+
+    static void onTimer(void* cookie, int64_t now) {
+        Fired* fired = static_cast<Fired*>(cookie);
+        fired->count++;
+        fired->at = now;
+        if (fired->again > 0) {
+            fired->again--;
+            fired->wheel->schedule(fired->timer, now + fired->period);
+        }
+    }
+};
+
+}; // namespace
+
+static bool readable(TimerWheel& wheel, int ms)
+{
+    struct pollfd fd = { wheel.getFd(), POLLIN, 0 };
+    return poll(&fd, 1, ms) == 1;
+}
+
+// neither early nor a tick late
+static void expectOnTime(const Fired& fired, int64_t when)
+{
+    EXPECT(fired.at >= when);
+    EXPECT(fired.at < when + 2 * SLACK_NS + 20 * MS);
+}
+
+static void testSameSlot()
+{
+    TimerWheel wheel;
+    wheel.setSlack(SLACK_NS);
+    Fired a, b;
+    SensorTimer ta, tb;
+    ta.init(Fired::onTimer, &a);
+    tb.init(Fired::onTimer, &b);
+
+    // one turn apart, so in the same slot: only the first is due at first
+    const int64_t when = SensorBase::getTimestamp() + 30 * MS;
+    wheel.schedule(&ta, when);
+    wheel.schedule(&tb, when + TURN_NS);
+
+    EXPECT(readable(wheel, 1000));
+    EXPECT_EQ(wheel.expire(), 1);
+    EXPECT_EQ(a.count, 1);
+    EXPECT_EQ(b.count, 0);
+    EXPECT(tb.isPending());
+    expectOnTime(a, when);
+
+    EXPECT(readable(wheel, 1000));
+    EXPECT_EQ(wheel.expire(), 1);
+    EXPECT_EQ(b.count, 1);
+    expectOnTime(b, when + TURN_NS);
+
+    // nothing left, nothing armed
+    EXPECT(!readable(wheel, 50));
+}
+
+static void testLateExpire()
+{
+    TimerWheel wheel;
+    wheel.setSlack(SLACK_NS);
+    Fired a, b, c;
+    SensorTimer ta, tb, tc;
+    ta.init(Fired::onTimer, &a);
+    tb.init(Fired::onTimer, &b);
+    tc.init(Fired::onTimer, &c);
+
+    const int64_t now = SensorBase::getTimestamp();
+    wheel.schedule(&ta, now + 10 * MS);
+    wheel.schedule(&tb, now + 50 * MS);
+    wheel.schedule(&tc, now + 3 * TURN_NS);
+
+    // the poll thread was busy for more than a turn: the due ones all go at
+    // once, the one a few turns on stays
+    usleep((TURN_NS + 10 * SLACK_NS) / 1000);
+    EXPECT(readable(wheel, 0));
+    EXPECT_EQ(wheel.expire(), 2);
+    EXPECT_EQ(a.count, 1);
+    EXPECT_EQ(b.count, 1);
+    EXPECT_EQ(c.count, 0);
+    EXPECT(tc.isPending());
+
+    // and the wheel goes on from there
+    EXPECT(!readable(wheel, 50));
+    wheel.schedule(&ta, SensorBase::getTimestamp() + 20 * MS);
+    EXPECT(readable(wheel, 1000));
+    EXPECT_EQ(wheel.expire(), 1);
+    EXPECT_EQ(a.count, 2);
+    EXPECT_EQ(c.count, 0);
+    wheel.cancel(&tc);
+    EXPECT(!tc.isPending());
+}
+
+static void testRearm()
+{
+    TimerWheel wheel;
+    wheel.setSlack(SLACK_NS);
+    Fired a, b;
+    SensorTimer ta, tb;
+    ta.init(Fired::onTimer, &a);
+    tb.init(Fired::onTimer, &b);
+
+    // cancelling the earliest timer moves the timerfd to the next one
+    int64_t now = SensorBase::getTimestamp();
+    wheel.schedule(&ta, now + 50 * MS);
+    wheel.schedule(&tb, now + 300 * MS);
+    wheel.cancel(&ta);
+    EXPECT(!readable(wheel, 150));
+    EXPECT(readable(wheel, 1000));
+    EXPECT_EQ(wheel.expire(), 1);
+    EXPECT_EQ(a.count, 0);
+    EXPECT_EQ(b.count, 1);
+
+    // and cancelling the last one disarms it
+    wheel.schedule(&ta, SensorBase::getTimestamp() + 50 * MS);
+    wheel.schedule(&ta, 0);
+    EXPECT(!readable(wheel, 150));
+
+    // so does moving it later
+    now = SensorBase::getTimestamp();
+    wheel.schedule(&ta, now + 50 * MS);
+    wheel.schedule(&ta, now + 250 * MS);
+    EXPECT(!readable(wheel, 150));
+    EXPECT(readable(wheel, 1000));
+    EXPECT_EQ(wheel.expire(), 1);
+    expectOnTime(a, now + 250 * MS);
+
+    // or earlier
+    now = SensorBase::getTimestamp();
+    wheel.schedule(&ta, now + 500 * MS);
+    wheel.schedule(&ta, now + 30 * MS);
+    EXPECT(readable(wheel, 300));
+    EXPECT_EQ(wheel.expire(), 1);
+    expectOnTime(a, now + 30 * MS);
+}
+
+static void testReschedule()
+{
+    TimerWheel wheel;
+    wheel.setSlack(SLACK_NS);
+    Fired a;
+    SensorTimer ta;
+    ta.init(Fired::onTimer, &a);
+
+    // a periodic timer schedules itself again from its callback
+    a.wheel = &wheel;
+    a.timer = &ta;
+    a.period = 20 * MS;
+    a.again = 2;
+    wheel.schedule(&ta, SensorBase::getTimestamp() + 20 * MS);
+    for (int i=0 ; i<3 ; i++) {
+        EXPECT(readable(wheel, 1000));
+        const int64_t last = a.at;
+        EXPECT_EQ(wheel.expire(), 1);
+        if (i) {
+            EXPECT(a.at >= last + a.period);
+        }
+    }
+    EXPECT_EQ(a.count, 3);
+    EXPECT(!ta.isPending());
+    EXPECT(!readable(wheel, 100));
+
+    // a timer due already fires on the next tick, not in the past
+    wheel.schedule(&ta, SensorBase::getTimestamp() - 100 * MS);
+    EXPECT(readable(wheel, 100));
+    EXPECT_EQ(wheel.expire(), 1);
+    EXPECT_EQ(a.count, 4);
+}
+
+void testTimerWheel()
+{
+    testSameSlot();
+    testLateExpire();
+    testRearm();
+    testReschedule();
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host unit tests of the HAL pieces that do not need a device or the poll
+ * thread: the timer wheel, the accelerometer FIFO and the detectors fed
+ * from it. Where the storm test checks that the threads agree, these check
+ * the arithmetic, with the detectors driven by synthetic samples around
+ * their thresholds.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "unit_test.h"
+
+/*****************************************************************************/
+
+static int sChecks;
+static int sFailures;
+
+bool expect(bool ok, const char* file, int line, const char* what)
+{
+    sChecks++;
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s:%d: %s\n", file, line, what);
+        sFailures++;
+    }
+    return ok;
+}
+
+bool expectEq(int64_t actual, int64_t expected, const char* file, int line,
+        const char* what)
+{
+    sChecks++;
+    if (actual != expected) {
+        fprintf(stderr, "FAIL: %s:%d: %s is %lld, expected %lld\n", file, line,
+                what, (long long)actual, (long long)expected);
+        sFailures++;
+        return false;
+    }
+    return true;
+}
+
+static const struct {
+    const char* name;
+    void (*run)();
+} sTests[] = {
+    { "TimerWheel",         testTimerWheel },
+    { "AccelFifo",          testAccelFifo },
+    { "SignificantMotion",  testSignificantMotion },
+    { "StepCounter",        testStepCounter },
+    { "FaceDown",           testFaceDown },
+    { "GestureDetector",    testGestureDetector },
+    { "RotationBoost",      testRotationBoost },
+};
+
+int main(int argc, char** argv)
+{
+    for (size_t i=0 ; i<sizeof(sTests)/sizeof(sTests[0]) ; i++) {
+        // a name on the command line runs only that test
+        if (argc > 1 && strcmp(argv[1], sTests[i].name))
+            continue;
+        const int failures = sFailures;
+        sTests[i].run();
+        printf("%-20s %s\n", sTests[i].name, sFailures == failures ? "ok" : "FAILED");
+    }
+
+    printf("%s: %d checks, %d failures\n",
+            sFailures ? "FAILED" : "PASSED", sChecks, sFailures);
+    return sFailures ? 1 : 0;
+}
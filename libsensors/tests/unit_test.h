@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSORS_UNIT_TEST_H
+#define ANDROID_SENSORS_UNIT_TEST_H
+
+#include <stdint.h>
+
+/*****************************************************************************/
+
+/*
+ * Checks for the host unit tests of the pieces of the HAL that do not need
+ * a device, see unit_test.cpp. A failed check is reported and counted, and
+ * the test goes on.
+ */
+
+#define EXPECT(cond) \
+    expect((cond), __FILE__, __LINE__, #cond)
+
+#define EXPECT_EQ(actual, expected) \
+    expectEq((actual), (expected), __FILE__, __LINE__, #actual)
+
+bool expect(bool ok, const char* file, int line, const char* what);
+bool expectEq(int64_t actual, int64_t expected, const char* file, int line,
+        const char* what);
+
+// the tests, one per component
+void testTimerWheel();
+void testAccelFifo();
+void testSignificantMotion();
+void testStepCounter();
+void testFaceDown();
+void testGestureDetector();
+void testRotationBoost();
+
+/*****************************************************************************/
+
+#endif  // ANDROID_SENSORS_UNIT_TEST_H
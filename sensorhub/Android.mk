@@ -0,0 +1,32 @@
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH := $(call my-dir)
+
+# Shares one sensors HAL stream between native clients, see sensorhub.h
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensorhubd
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := sensorhubd.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../libsensors
+
+LOCAL_SHARED_LIBRARIES := liblog libcutils libhardware
+
+include $(BUILD_EXECUTABLE)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
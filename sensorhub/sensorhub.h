@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSORHUB_H
+#define ANDROID_SENSORHUB_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/cdefs.h>
+
+#include <hardware/sensors.h>
+
+__BEGIN_DECLS
+
+/*****************************************************************************/
+
+/*
+ * sensorhubd shares one hardware stream between any number of native
+ * clients, without going through the framework.
+ *
+ * A client connects to the SOCK_SEQPACKET socket below and is greeted with
+ * a SENSORHUB_HELLO message carrying, as SCM_RIGHTS, the fd of an ashmem
+ * region of msg.status bytes that holds its sensorhub_ring. It then sends
+ * SENSORHUB_SUBSCRIBE/SENSORHUB_UNSUBSCRIBE requests, each answered by a
+ * SENSORHUB_STATUS message. Events matching the client's subscriptions are
+ * decimated to the requested period and written into its ring; the hub
+ * sends SENSORHUB_EVENTS only when the ring goes from empty to non-empty,
+ * so a client that drains the ring after every notification never misses
+ * one and costs no socket traffic while it keeps up.
+ *
+ * A client that cannot afford even that may register a direct channel:
+ * an ashmem region of its own, sent with SENSORHUB_DIRECT_REGISTER
+ * (msg.status is its size), that the hub turns into a sensorhub_direct.
+ * SENSORHUB_DIRECT_CONFIGURE then routes a handle there at a given period
+ * (negative to stop). The hub writes events into the region and nothing
+ * else, no message is ever sent: the client polls it whenever it wants
+ * the latest samples, e.g. once per frame, with sensorhub_direct_read().
+ */
+
+#define SENSORHUB_SOCKET    "sensorhub"
+
+enum {
+    SENSORHUB_HELLO         = 1,    // hub -> client, ring fd attached
+    SENSORHUB_SUBSCRIBE     = 2,    // client -> hub
+    SENSORHUB_UNSUBSCRIBE   = 3,    // client -> hub
+    SENSORHUB_STATUS        = 4,    // hub -> client, answers a request
+    SENSORHUB_EVENTS        = 5,    // hub -> client, the ring has events
+    SENSORHUB_DIRECT_REGISTER  = 6, // client -> hub, region fd attached
+    SENSORHUB_DIRECT_CONFIGURE = 7, // client -> hub
+};
+
+struct sensorhub_msg {
+    int32_t what;
+    int32_t handle;
+    int64_t period_ns;              // 0 for the fastest rate
+    int32_t status;                 // 0 or -errno, ring size for HELLO
+    int32_t reserved;
+};
+
+struct sensorhub_ring {
+    volatile uint32_t head;         // written by the hub
+    volatile uint32_t tail;         // written by the client
+    uint32_t capacity;              // in events, a power of two
+    volatile uint32_t dropped;      // events lost to a full ring
+    sensors_event_t events[0];
+};
+
+/*
+ * Direct channel layout. Slots are overwritten in turn, there is no
+ * backpressure; each one is guarded by its own sequence counter, odd
+ * while the hub is writing it, so a reader never needs to take a lock
+ * nor write to the region, and any number of readers may share it.
+ * The counter of the slot holding event n is derived from n, see
+ * sensorhub_direct_seq(), so a reader can also tell a slot that has
+ * been overwritten by a later lap.
+ */
+struct sensorhub_direct_slot {
+    volatile uint32_t seq;
+    uint32_t reserved;
+    sensors_event_t event;
+};
+
+struct sensorhub_direct {
+    volatile uint32_t count;        // events written since registration
+    uint32_t capacity;              // in slots, a power of two
+    uint32_t reserved[2];
+    struct sensorhub_direct_slot slots[0];
+};
+
+/*
+ * Sequence number of the slot holding event n once it is written, one
+ * less while it is being written.
+ */
+static inline uint32_t sensorhub_direct_seq(uint32_t n, uint32_t capacity)
+{
+    return (n / capacity) * 2 + 2;
+}
+
+/*
+ * Copies up to count events written since *cursor, which starts at 0, and
+ * advances it. Returns how many were copied; events overwritten before
+ * they could be read are skipped and added to *lost if it isn't NULL.
+ */
+static inline int sensorhub_direct_read(struct sensorhub_direct const* direct,
+        uint32_t* cursor, sensors_event_t* data, int count, uint32_t* lost)
+{
+    uint32_t written = direct->count;
+    uint32_t next = *cursor;
+    int n = 0;
+
+    __sync_synchronize();   // see the slots the count covers
+    if (written - next > direct->capacity) {
+        if (lost)
+            *lost += written - next - direct->capacity;
+        next = written - direct->capacity;
+    }
+    while (next != written && n < count) {
+        struct sensorhub_direct_slot const* slot =
+                &direct->slots[next & (direct->capacity - 1)];
+        uint32_t seq = slot->seq;
+        __sync_synchronize();
+        data[n] = slot->event;
+        __sync_synchronize();
+        if (seq != sensorhub_direct_seq(next, direct->capacity) || seq != slot->seq) {
+            // the hub lapped us while we were copying
+            if (lost)
+                *lost += 1;
+        } else {
+            n++;
+        }
+        next++;
+    }
+    *cursor = next;
+    return n;
+}
+
+/*
+ * Writer side of a direct channel, used by the hub. The region may be
+ * scribbled over by its owner at any time, so everything the writer
+ * indexes it with lives here and it only ever stores to the region.
+ */
+struct sensorhub_direct_writer {
+    struct sensorhub_direct* direct;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+/*
+ * Lays a direct channel out over size bytes at base. Returns -EINVAL if
+ * not even one slot fits.
+ */
+static inline int sensorhub_direct_init(struct sensorhub_direct_writer* writer,
+        void* base, size_t size)
+{
+    if (size < sizeof(struct sensorhub_direct) + sizeof(struct sensorhub_direct_slot))
+        return -EINVAL;
+
+    uint32_t slots = (size - sizeof(struct sensorhub_direct)) / sizeof(struct sensorhub_direct_slot);
+    uint32_t capacity = 1;
+    while (capacity * 2 <= slots) {
+        capacity *= 2;
+    }
+    writer->direct = (struct sensorhub_direct*)base;
+    writer->capacity = capacity;
+    writer->count = 0;
+    memset(base, 0, sizeof(struct sensorhub_direct) + capacity * sizeof(struct sensorhub_direct_slot));
+    writer->direct->capacity = capacity;
+    __sync_synchronize();
+    return 0;
+}
+
+static inline void sensorhub_direct_write(struct sensorhub_direct_writer* writer,
+        sensors_event_t const* event)
+{
+    uint32_t n = writer->count;
+    uint32_t seq = sensorhub_direct_seq(n, writer->capacity);
+    struct sensorhub_direct_slot* slot = &writer->direct->slots[n & (writer->capacity - 1)];
+    slot->seq = seq - 1;
+    __sync_synchronize();   // odd before the event changes
+    slot->event = *event;
+    __sync_synchronize();   // the event before the even number
+    slot->seq = seq;
+    writer->count = ++n;
+    __sync_synchronize();
+    writer->direct->count = n;
+}
+
+/*
+ * Copies up to count events out of the ring, returns how many.
+ */
+static inline int sensorhub_ring_read(struct sensorhub_ring* ring,
+        sensors_event_t* data, int count)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
+    int n = 0;
+
+    __sync_synchronize();   // see the events before their head
+    while (tail != head && n < count) {
+        data[n++] = ring->events[tail & (ring->capacity - 1)];
+        tail++;
+    }
+    __sync_synchronize();   // done with the slots before releasing them
+    ring->tail = tail;
+    return n;
+}
+
+/*****************************************************************************/
+
+__END_DECLS
+
+#endif  // ANDROID_SENSORHUB_H
@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "sensorhubd"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <cutils/ashmem.h>
+#include <cutils/log.h>
+#include <cutils/sockets.h>
+
+#include <hardware/hardware.h>
+#include <hardware/sensors.h>
+
+#include "sensorhub.h"
+
+// for SENSORS_HARDWARE_POLL_SECONDARY, the HAL instance that shares the
+// hardware with the framework's instead of fighting over it
+#include "nusensors.h"
+
+/*****************************************************************************/
+
+#define MAX_CLIENTS     16
+#define MAX_HANDLES     32
+#define RING_EVENTS     256     // per client, a power of two
+#define POLL_EVENTS     64
+
+/*
+ * The client can write to its ring and its direct region at any time, so
+ * whatever the hub indexes them with is kept here, and the only value it
+ * reads back from them is the ring's tail.
+ */
+struct client_t {
+    int fd;                     // -1 when the slot is free
+    int ringFd;
+    struct sensorhub_ring* ring;
+    uint32_t head;              // what ring->head should be
+    uint32_t capacity;          // of the ring, a power of two
+    int64_t period[MAX_HANDLES];    // -1 when not subscribed
+    int64_t last[MAX_HANDLES];      // timestamp of the last event written
+    struct sensorhub_direct_writer direct;  // direct.direct NULL until registered
+    size_t directSize;
+    int64_t directPeriod[MAX_HANDLES];  // -1 when not routed there
+    int64_t directLast[MAX_HANDLES];
+};
+
+static struct sensors_poll_device_t* sDevice;
+static struct sensor_t const* sSensors[MAX_HANDLES];
+
+// main loop only
+static int64_t sHardwarePeriod[MAX_HANDLES];    // -1 when deactivated
+
+// everything below is shared between the poll thread and the main loop
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static client_t sClients[MAX_CLIENTS];
+static uint32_t sFired;         // one-shot handles the HAL has turned off
+
+/*****************************************************************************/
+
+static size_t ringSize()
+{
+    return sizeof(struct sensorhub_ring) + RING_EVENTS * sizeof(sensors_event_t);
+}
+
+static bool isOneShot(int handle)
+{
+    return sSensors[handle]->minDelay < 0;
+}
+
+/*
+ * Applies the union of all subscriptions to the HAL: a handle is active
+ * while anybody listens, at the fastest period anybody asked for.
+ * Called from the main loop without sLock: the wanted state is taken
+ * under it, the HAL is called after, so the poll thread keeps delivering
+ * meanwhile. Returns -EIO if the given handle is wanted but not active.
+ */
+static int updateHardware(int handle)
+{
+    int64_t wanted[MAX_HANDLES];
+
+    pthread_mutex_lock(&sLock);
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        if (sFired & (1u << h)) {
+            sHardwarePeriod[h] = -1;
+        }
+        int64_t period = -1;
+        for (int i=0 ; sSensors[h] && i<MAX_CLIENTS ; i++) {
+            if (sClients[i].fd < 0)
+                continue;
+            int64_t p = sClients[i].period[h];
+            if (p >= 0 && (period < 0 || p < period)) {
+                period = p;
+            }
+            p = sClients[i].directPeriod[h];
+            if (p >= 0 && (period < 0 || p < period)) {
+                period = p;
+            }
+        }
+        wanted[h] = period;
+    }
+    sFired = 0;
+    pthread_mutex_unlock(&sLock);
+
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        const int64_t period = wanted[h];
+        if (!sSensors[h] || period == sHardwarePeriod[h])
+            continue;
+
+        int err = 0;
+        if (period < 0) {
+            err = sDevice->activate(sDevice, h, 0);
+        } else {
+            if (sHardwarePeriod[h] < 0) {
+                err = sDevice->activate(sDevice, h, 1);
+            }
+            if (!err && !isOneShot(h)) {
+                err = sDevice->setDelay(sDevice, h, period);
+            }
+        }
+        ALOGE_IF(err, "failed to configure handle %d (%s)", h, strerror(-err));
+        sHardwarePeriod[h] = err ? -1 : period;
+    }
+    return handle >= 0 && wanted[handle] >= 0 && sHardwarePeriod[handle] < 0 ? -EIO : 0;
+}
+
+static int sendMessage(int fd, struct sensorhub_msg const* msg, int ringFd)
+{
+    struct iovec iov;
+    iov.iov_base = (void*)msg;
+    iov.iov_len = sizeof(*msg);
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    if (ringFd >= 0) {
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof(control);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &ringFd, sizeof(int));
+    }
+
+    return sendmsg(fd, &hdr, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 ? -errno : 0;
+}
+
+/*
+ * Receives one request; an fd passed along with it is returned in *fd,
+ * -1 otherwise.
+ */
+static ssize_t recvMessage(int fd, struct sensorhub_msg* msg, int* passedFd)
+{
+    struct iovec iov;
+    iov.iov_base = msg;
+    iov.iov_len = sizeof(*msg);
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+
+    *passedFd = -1;
+    ssize_t size = recvmsg(fd, &hdr, MSG_DONTWAIT);
+    struct cmsghdr* cmsg = size > 0 ? CMSG_FIRSTHDR(&hdr) : NULL;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(passedFd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    return size;
+}
+
+static void removeClient(client_t* client)
+{
+    pthread_mutex_lock(&sLock);
+    close(client->fd);
+    client->fd = -1;
+    munmap(client->ring, ringSize());
+    close(client->ringFd);
+    client->ring = NULL;
+    if (client->direct.direct) {
+        munmap(client->direct.direct, client->directSize);
+        client->direct.direct = NULL;
+    }
+    pthread_mutex_unlock(&sLock);
+    updateHardware(-1);
+}
+
+static void addClient(int fd)
+{
+    pthread_mutex_lock(&sLock);
+    client_t* client = NULL;
+    for (int i=0 ; i<MAX_CLIENTS && !client ; i++) {
+        if (sClients[i].fd < 0) {
+            client = &sClients[i];
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+
+    if (!client) {
+        ALOGW("too many clients, refusing connection");
+        close(fd);
+        return;
+    }
+
+    int ringFd = ashmem_create_region("sensorhub", ringSize());
+    void* ring = ringFd >= 0 ?
+            mmap(NULL, ringSize(), PROT_READ | PROT_WRITE, MAP_SHARED, ringFd, 0) : MAP_FAILED;
+    if (ring == MAP_FAILED) {
+        ALOGE("couldn't create client ring (%s)", strerror(errno));
+        if (ringFd >= 0)
+            close(ringFd);
+        close(fd);
+        return;
+    }
+
+    struct sensorhub_msg hello;
+    memset(&hello, 0, sizeof(hello));
+    hello.what = SENSORHUB_HELLO;
+    hello.status = ringSize();
+
+    client->ring = static_cast<struct sensorhub_ring*>(ring);
+    client->ring->capacity = RING_EVENTS;
+    client->head = 0;
+    client->capacity = RING_EVENTS;
+    client->ringFd = ringFd;
+    client->direct.direct = NULL;
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        client->period[h] = -1;
+        client->last[h] = 0;
+        client->directPeriod[h] = -1;
+        client->directLast[h] = 0;
+    }
+    if (sendMessage(fd, &hello, ringFd) < 0) {
+        munmap(ring, ringSize());
+        close(ringFd);
+        close(fd);
+        client->ring = NULL;
+        return;
+    }
+
+    // publishing the fd makes the slot visible to the poll thread
+    pthread_mutex_lock(&sLock);
+    client->fd = fd;
+    pthread_mutex_unlock(&sLock);
+}
+
+/*
+ * Only ashmem is accepted: its size is fixed once mapped, so the client
+ * can't truncate the region under the hub and have it killed by SIGBUS.
+ */
+static int registerDirect(client_t* client, struct sensorhub_msg const* msg, int fd)
+{
+    if (fd < 0)
+        return -EINVAL;
+    if (client->direct.direct)
+        return -EBUSY;
+
+    int size = ashmem_get_size_region(fd);
+    if (size < 0 || size < msg->status)
+        return -EINVAL;
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return -errno;
+
+    struct sensorhub_direct_writer direct;
+    int err = sensorhub_direct_init(&direct, base, size);
+    if (err) {
+        munmap(base, size);
+        return err;
+    }
+
+    pthread_mutex_lock(&sLock);
+    client->direct = direct;
+    client->directSize = size;
+    pthread_mutex_unlock(&sLock);
+    return 0;
+}
+
+static int handleRequest(client_t* client, struct sensorhub_msg const* msg, int fd)
+{
+    if (msg->what == SENSORHUB_DIRECT_REGISTER)
+        return registerDirect(client, msg, fd);
+
+    int h = msg->handle;
+    if (h < 0 || h >= MAX_HANDLES || !sSensors[h])
+        return -EINVAL;
+
+    pthread_mutex_lock(&sLock);
+    switch (msg->what) {
+        case SENSORHUB_SUBSCRIBE:
+            client->period[h] = msg->period_ns > 0 ? msg->period_ns : 0;
+            client->last[h] = 0;
+            break;
+        case SENSORHUB_UNSUBSCRIBE:
+            client->period[h] = -1;
+            break;
+        case SENSORHUB_DIRECT_CONFIGURE:
+            if (!client->direct.direct) {
+                pthread_mutex_unlock(&sLock);
+                return -ENODEV;
+            }
+            client->directPeriod[h] = msg->period_ns < 0 ? -1 : msg->period_ns;
+            client->directLast[h] = 0;
+            break;
+    }
+    pthread_mutex_unlock(&sLock);
+    return updateHardware(h);
+}
+
+static bool isDue(int64_t timestamp, int64_t last, int64_t period)
+{
+    return timestamp - last >= period - period / 8;
+}
+
+/*
+ * Writes the events routed to a direct channel. Called with sLock held.
+ */
+static void deliverDirect(client_t* client, sensors_event_t const* events, int count)
+{
+    for (int e=0 ; e<count ; e++) {
+        int h = events[e].sensor;
+        if (h < 0 || h >= MAX_HANDLES || client->directPeriod[h] < 0)
+            continue;
+        if (!isDue(events[e].timestamp, client->directLast[h], client->directPeriod[h]))
+            continue;
+
+        sensorhub_direct_write(&client->direct, &events[e]);
+        client->directLast[h] = events[e].timestamp;
+        if (isOneShot(h)) {
+            client->directPeriod[h] = -1;
+        }
+    }
+}
+
+/*
+ * Fans a batch out to every client ring, keeping only the events that are
+ * at least the client's period apart (less 1/8th, for hardware jitter).
+ */
+static void deliver(sensors_event_t const* events, int count)
+{
+    pthread_mutex_lock(&sLock);
+    for (int i=0 ; i<MAX_CLIENTS ; i++) {
+        client_t* client = &sClients[i];
+        if (client->fd < 0)
+            continue;
+
+        if (client->direct.direct) {
+            deliverDirect(client, events, count);
+        }
+
+        struct sensorhub_ring* ring = client->ring;
+        const uint32_t start = client->head;
+        const uint32_t tail = ring->tail;
+        // a tail outside [head - capacity, head] is a broken client, treat it as full
+        uint32_t used = start - tail;
+        if (used > client->capacity) {
+            used = client->capacity;
+        }
+        uint32_t head = start;
+        for (int e=0 ; e<count ; e++) {
+            int h = events[e].sensor;
+            if (h < 0 || h >= MAX_HANDLES || client->period[h] < 0)
+                continue;
+
+            if (!isDue(events[e].timestamp, client->last[h], client->period[h]))
+                continue;
+
+            if (used >= client->capacity) {
+                ring->dropped++;
+                continue;
+            }
+            ring->events[head & (client->capacity - 1)] = events[e];
+            head++;
+            used++;
+            client->last[h] = events[e].timestamp;
+            if (isOneShot(h)) {
+                client->period[h] = -1;
+            }
+        }
+        if (head == start)
+            continue;
+
+        __sync_synchronize();   // the events before the head that covers them
+        ring->head = head;
+        client->head = head;
+        __sync_synchronize();
+        if (tail == start) {
+            // the client had caught up, so it may be waiting on the socket
+            struct sensorhub_msg msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.what = SENSORHUB_EVENTS;
+            sendMessage(client->fd, &msg, -1);
+        }
+    }
+
+    // one-shot sensors have turned themselves off in the HAL
+    for (int e=0 ; e<count ; e++) {
+        int h = events[e].sensor;
+        if (h >= 0 && h < MAX_HANDLES && sSensors[h] && isOneShot(h)) {
+            sFired |= 1u << h;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+}
+
+static void* pollThread(void*)
+{
+    sensors_event_t buffer[POLL_EVENTS];
+
+    for (;;) {
+        int n = sDevice->poll(sDevice, buffer, POLL_EVENTS);
+        if (n < 0) {
+            ALOGE("poll() failed (%s)", strerror(-n));
+            usleep(100000);
+            continue;
+        }
+        deliver(buffer, n);
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+
+int main(int argc, char** argv)
+{
+    struct sensors_module_t const* module;
+    int err = hw_get_module(SENSORS_HARDWARE_MODULE_ID, (hw_module_t const**)&module);
+    if (err) {
+        ALOGE("couldn't load %s module (%s)", SENSORS_HARDWARE_MODULE_ID, strerror(-err));
+        return 1;
+    }
+    err = module->common.methods->open(&module->common, SENSORS_HARDWARE_POLL_SECONDARY,
+            (hw_device_t**)&sDevice);
+    if (err) {
+        ALOGE("couldn't open device for module %s (%s)", SENSORS_HARDWARE_MODULE_ID, strerror(-err));
+        return 1;
+    }
+
+    struct sensor_t const* list;
+    int count = module->get_sensors_list(const_cast<sensors_module_t*>(module), &list);
+    for (int i=0 ; i<count ; i++) {
+        if (list[i].handle >= 0 && list[i].handle < MAX_HANDLES) {
+            sSensors[list[i].handle] = &list[i];
+        }
+    }
+    for (int h=0 ; h<MAX_HANDLES ; h++) {
+        sHardwarePeriod[h] = -1;
+    }
+    for (int i=0 ; i<MAX_CLIENTS ; i++) {
+        sClients[i].fd = -1;
+    }
+
+    int listenFd = android_get_control_socket(SENSORHUB_SOCKET);
+    if (listenFd < 0 || listen(listenFd, 4) < 0) {
+        ALOGE("couldn't listen on socket %s (%s)", SENSORHUB_SOCKET, strerror(errno));
+        return 1;
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, pollThread, NULL);
+
+    struct pollfd fds[MAX_CLIENTS + 1];
+    client_t* owners[MAX_CLIENTS + 1];
+    for (;;) {
+        int nfds = 0;
+        fds[nfds].fd = listenFd;
+        fds[nfds].events = POLLIN;
+        owners[nfds++] = NULL;
+        // only this thread adds or removes clients, no lock needed to look
+        for (int i=0 ; i<MAX_CLIENTS ; i++) {
+            if (sClients[i].fd >= 0) {
+                fds[nfds].fd = sClients[i].fd;
+                fds[nfds].events = POLLIN;
+                owners[nfds++] = &sClients[i];
+            }
+        }
+
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno != EINTR) {
+                ALOGE("poll() failed (%s)", strerror(errno));
+            }
+            continue;
+        }
+
+        for (int i=1 ; i<nfds ; i++) {
+            if (!fds[i].revents)
+                continue;
+
+            struct sensorhub_msg msg;
+            int passedFd;
+            ssize_t size = recvMessage(fds[i].fd, &msg, &passedFd);
+            if (size == 0 || (size < 0 && errno != EAGAIN)) {
+                if (passedFd >= 0)
+                    close(passedFd);
+                removeClient(owners[i]);
+                continue;
+            }
+            if (size != sizeof(msg)) {
+                if (passedFd >= 0)
+                    close(passedFd);
+                continue;
+            }
+
+            msg.status = handleRequest(owners[i], &msg, passedFd);
+            // the mapping, if any, keeps the region alive
+            if (passedFd >= 0)
+                close(passedFd);
+            msg.what = SENSORHUB_STATUS;
+            sendMessage(fds[i].fd, &msg, -1);
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd >= 0) {
+                addClient(fd);
+            }
+        }
+    }
+
+    return 0;
+}
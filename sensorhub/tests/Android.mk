@@ -0,0 +1,28 @@
+# Copyright (C) 2013 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+LOCAL_PATH := $(call my-dir)
+
+# Writer and reader processes sharing a direct channel, see direct_test.cpp
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := sensorhub_direct_test
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_SRC_FILES := direct_test.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/.. hardware/libhardware/include
+
+include $(BUILD_HOST_EXECUTABLE)
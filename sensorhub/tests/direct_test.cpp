@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host test of the direct channel: the writer runs in this process and
+ * reader processes follow it over a shared mapping, as clients of the hub
+ * would. Every event a reader returns must be whole and in order, and
+ * what it read plus what it was told it lost must add up to what was
+ * written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "sensorhub.h"
+
+#define SLOTS       64
+#define EVENTS      200000
+#define READERS     3
+
+static void fill(sensors_event_t* event, uint32_t n)
+{
+    memset(event, 0, sizeof(*event));
+    event->version = sizeof(*event);
+    event->timestamp = n;
+    for (int i=0 ; i<16 ; i++) {
+        event->data[i] = float(n % 100000 + i);
+    }
+}
+
+static bool isWhole(sensors_event_t const* event)
+{
+    uint32_t n = uint32_t(event->timestamp);
+    for (int i=0 ; i<16 ; i++) {
+        if (event->data[i] != float(n % 100000 + i))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Reader r sleeps every (r * 1000) events, so the later ones get lapped.
+ */
+static int reader(struct sensorhub_direct const* direct, int r)
+{
+    sensors_event_t buffer[16];
+    uint32_t cursor = 0;
+    uint32_t lost = 0;
+    uint32_t read = 0;
+    int64_t last = -1;
+
+    while (cursor < EVENTS) {
+        int n = sensorhub_direct_read(direct, &cursor, buffer, 16, &lost);
+        for (int i=0 ; i<n ; i++) {
+            if (!isWhole(&buffer[i])) {
+                fprintf(stderr, "reader %d: torn event %lld\n", r, (long long)buffer[i].timestamp);
+                return 1;
+            }
+            if (buffer[i].timestamp <= last) {
+                fprintf(stderr, "reader %d: event %lld after %lld\n",
+                        r, (long long)buffer[i].timestamp, (long long)last);
+                return 1;
+            }
+            last = buffer[i].timestamp;
+        }
+        if (r && (read / (r * 1000)) != ((read + n) / (r * 1000))) {
+            usleep(100);
+        }
+        read += n;
+    }
+    if (read + lost != EVENTS) {
+        fprintf(stderr, "reader %d: read %u + lost %u != %u\n", r, read, lost, EVENTS);
+        return 1;
+    }
+    printf("reader %d: read %u, lost %u\n", r, read, lost);
+    return 0;
+}
+
+/*
+ * The writer must not be steered by what the region's owner stores there.
+ */
+static int scribble()
+{
+    size_t size = sizeof(struct sensorhub_direct) + 4 * sizeof(struct sensorhub_direct_slot);
+    void* base = calloc(1, size);
+    struct sensorhub_direct_writer writer;
+    sensors_event_t event;
+
+    if (sensorhub_direct_init(&writer, base, size) || writer.capacity != 4) {
+        fprintf(stderr, "scribble: bad layout\n");
+        return 1;
+    }
+    struct sensorhub_direct* direct = writer.direct;
+    fill(&event, 0);
+    sensorhub_direct_write(&writer, &event);
+    direct->count = 0x7fffffff;
+    direct->capacity = 0x10000;
+    direct->slots[1].seq = 0xffffffff;
+    fill(&event, 1);
+    sensorhub_direct_write(&writer, &event);
+    if (writer.count != 2 || direct->count != 2 ||
+            direct->slots[1].seq != sensorhub_direct_seq(1, 4) ||
+            direct->slots[1].event.timestamp != 1) {
+        fprintf(stderr, "scribble: the writer followed the region\n");
+        return 1;
+    }
+    free(base);
+    return 0;
+}
+
+int main()
+{
+    if (scribble())
+        return 1;
+
+    size_t size = sizeof(struct sensorhub_direct) + SLOTS * sizeof(struct sensorhub_direct_slot);
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    struct sensorhub_direct_writer writer;
+    sensorhub_direct_init(&writer, base, size);
+
+    pid_t pids[READERS];
+    for (int r=0 ; r<READERS ; r++) {
+        pids[r] = fork();
+        if (pids[r] == 0)
+            exit(reader(writer.direct, r));
+    }
+
+    sensors_event_t event;
+    for (uint32_t n=0 ; n<EVENTS ; n++) {
+        fill(&event, n);
+        sensorhub_direct_write(&writer, &event);
+        if (n % SLOTS == 0) {
+            sched_yield();
+        }
+    }
+
+    int failed = 0;
+    for (int r=0 ; r<READERS ; r++) {
+        int status;
+        waitpid(pids[r], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status))
+            failed++;
+    }
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}